@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Firmware write path benchmark.
+ *
+ * Feeds synthetic images to fota_write_block(), the LwM2M firmware
+ * write callback, for several image sizes, block sizes and sparsities
+ * (share of blocks left erased, all 0xff, which the write path skips),
+ * and prints the distribution of per-block latencies and the effective
+ * throughput of each run:
+ *
+ *   bench: bank image=<bytes> block=<bytes> sparse=<%> min=<us> ...
+ *
+ * Latencies are in simulated time: with the timings of
+ * timing-<soc>.conf, the flash simulator advances the clock as long
+ * as the real flash would be busy, so a run takes seconds.
+ *
+ *   west build -b native_posix bench/fota_write -- \
+ *	-DFLASH_TIMING=nrf52 [-DERASE_PROGRESSIVELY=y]
+ *   ./build/zephyr/zephyr.exe
+ */
+
+#include <ztest.h>
+#include <flash.h>
+
+#include "lwm2m.h"
+#include "fota_write.h"
+
+#define BANK_OFFSET		DT_FLASH_AREA_IMAGE_1_OFFSET
+#define BANK_SIZE		DT_FLASH_AREA_IMAGE_1_SIZE
+
+#define MIN_BLOCK_SIZE		64
+#define MAX_IMAGE_SIZE		MIN(256 * 1024, BANK_SIZE)
+#define MAX_BLOCKS		(MAX_IMAGE_SIZE / MIN_BLOCK_SIZE)
+
+static const u32_t image_sizes[] = { 32 * 1024, MAX_IMAGE_SIZE };
+static const u8_t sparsities[] = { 0, 50, 90 };
+
+static struct device *flash_dev;
+static u8_t block[FOTA_WRITE_BUF_SIZE];
+static u8_t readback[FOTA_WRITE_BUF_SIZE];
+static u32_t latency_us[MAX_BLOCKS];
+
+/* The write path cancels this before using bank 1; nothing to do here */
+void lwm2m_slot1_cleanup_cancel(void)
+{
+}
+
+static u32_t rand_next(u32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return *state >> 16;
+}
+
+/* Content of block 'num': random, or erased in 'sparse' % of blocks */
+static void block_fill(u8_t *buf, size_t len, u32_t num, u8_t sparse)
+{
+	u32_t state = num + 1;
+	size_t i;
+
+	if (rand_next(&state) % 100 < sparse) {
+		memset(buf, 0xff, len);
+		return;
+	}
+
+	for (i = 0; i < len; i++) {
+		buf[i] = rand_next(&state);
+	}
+}
+
+static void sort(u32_t *values, size_t count)
+{
+	size_t gap, i, j;
+	u32_t value;
+
+	for (gap = count / 2; gap > 0; gap /= 2) {
+		for (i = gap; i < count; i++) {
+			value = values[i];
+			for (j = i; j >= gap && values[j - gap] > value;
+			     j -= gap) {
+				values[j] = values[j - gap];
+			}
+			values[j] = value;
+		}
+	}
+}
+
+static void verify(u32_t image_size, u32_t block_size, u8_t sparse)
+{
+	u32_t offset, len;
+	int ret;
+
+	for (offset = 0; offset < image_size; offset += block_size) {
+		len = MIN(block_size, image_size - offset);
+		block_fill(block, len, offset / block_size, sparse);
+		ret = flash_read(flash_dev, BANK_OFFSET + offset, readback,
+				 len);
+		zassert_equal(ret, 0, "read at %u failed", offset);
+		zassert_mem_equal(block, readback, len,
+				  "bank 1 differs at %u", offset);
+	}
+}
+
+static void run(u32_t image_size, u32_t block_size, u8_t sparse)
+{
+	u32_t count = (image_size + block_size - 1) / block_size;
+	u32_t i, len, start, total_us = 0;
+	u64_t sum_us = 0;
+	int ret;
+
+	for (i = 0; i < count; i++) {
+		len = MIN(block_size, image_size - i * block_size);
+		block_fill(block, len, i, sparse);
+
+		start = k_cycle_get_32();
+		ret = fota_write_block(0, block, len, i == count - 1,
+				       image_size);
+		latency_us[i] = SYS_CLOCK_HW_CYCLES_TO_NS64(
+			k_cycle_get_32() - start) / NSEC_PER_USEC;
+
+		zassert_equal(ret, 0, "block %u failed: %d", i, ret);
+		sum_us += latency_us[i];
+	}
+	total_us = sum_us;
+
+	verify(image_size, block_size, sparse);
+
+	sort(latency_us, count);
+	TC_PRINT("bench: %s image=%u block=%u sparse=%u%% blocks=%u "
+		 "min=%u p50=%u p90=%u p99=%u max=%u mean=%u us "
+		 "total=%u ms throughput=%u B/s\n",
+		 IS_ENABLED(CONFIG_FOTA_ERASE_PROGRESSIVELY) ?
+		 "progressive" : "bank",
+		 image_size, block_size, sparse, count,
+		 latency_us[0], latency_us[count / 2],
+		 latency_us[count * 9 / 10], latency_us[count * 99 / 100],
+		 latency_us[count - 1], total_us / count,
+		 total_us / USEC_PER_MSEC,
+		 total_us ? (u32_t)((u64_t)image_size * USEC_PER_SEC /
+				    total_us) : 0);
+}
+
+static void bench_block_size(u32_t block_size)
+{
+	size_t i, j;
+
+	for (i = 0; i < ARRAY_SIZE(image_sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(sparsities); j++) {
+			run(image_sizes[i], block_size, sparsities[j]);
+		}
+	}
+}
+
+static void test_block_64(void)
+{
+	bench_block_size(64);
+}
+
+static void test_block_256(void)
+{
+	bench_block_size(256);
+}
+
+static void test_block_1024(void)
+{
+	bench_block_size(1024);
+}
+
+void test_main(void)
+{
+	flash_dev = device_get_binding(DT_FLASH_DEV_NAME);
+	zassert_not_null(flash_dev, "no flash device");
+	fota_write_init(flash_dev);
+
+	ztest_test_suite(fota_write,
+			 ztest_unit_test(test_block_64),
+			 ztest_unit_test(test_block_256),
+			 ztest_unit_test(test_block_1024));
+	ztest_run_test_suite(fota_write);
+}
@@ -0,0 +1,145 @@
+# Copyright (c) 2019 Foundries.io
+#
+# SPDX-License-Identifier: Apache-2.0
+
+# Minimal CoAP (RFC 7252) message codec, with the block-wise transfer
+# (RFC 7959) option helpers, shared by the scripts in this directory.
+# Python standard library only.
+
+import struct
+
+VERSION = 1
+
+# message types
+CON, NON, ACK, RST = 0, 1, 2, 3
+
+# method and response codes
+GET, POST, PUT, DELETE = 0x01, 0x02, 0x03, 0x04
+CREATED, DELETED, CHANGED, CONTENT = 0x41, 0x42, 0x44, 0x45
+BAD_REQUEST, NOT_FOUND = 0x80, 0x84
+
+STATUS = {
+    0x41: 'CREATED', 0x42: 'DELETED', 0x44: 'CHANGED', 0x45: 'CONTENT',
+    0x80: 'BAD_REQUEST', 0x81: 'UNAUTHORIZED', 0x84: 'NOT_FOUND',
+    0x85: 'METHOD_NOT_ALLOWED', 0x86: 'NOT_ACCEPTABLE',
+    0x8f: 'UNSUPPORTED_CONTENT_FORMAT', 0xa0: 'INTERNAL_SERVER_ERROR',
+}
+
+# option numbers
+OPT_OBSERVE = 6
+OPT_LOCATION_PATH = 8
+OPT_URI_PATH = 11
+OPT_CONTENT_FORMAT = 12
+OPT_URI_QUERY = 15
+OPT_ACCEPT = 17
+OPT_BLOCK2 = 23
+OPT_BLOCK1 = 27
+OPT_SIZE2 = 28
+OPT_SIZE1 = 60
+
+
+def encode_uint(value):
+    out = b''
+    while value:
+        out = bytes([value & 0xff]) + out
+        value >>= 8
+    return out
+
+
+def encode_ext(value):
+    if value < 13:
+        return value, b''
+    if value < 269:
+        return 13, bytes([value - 13])
+    return 14, struct.pack('!H', value - 269)
+
+
+def block_szx(size):
+    """SZX field for a block size in bytes."""
+    return size.bit_length() - 5
+
+
+def block_size(szx):
+    """Block size in bytes for an SZX field."""
+    return 1 << (szx + 4)
+
+
+def block_option(num, more, szx):
+    """Block1/Block2 option value."""
+    return encode_uint((num << 4) | (int(more) << 3) | szx)
+
+
+def block_fields(value):
+    """Block number, more flag and SZX of a Block1/Block2 option value."""
+    return value >> 4, bool(value & 0x8), value & 0x7
+
+
+class Message:
+    def __init__(self, mtype=CON, code=0, mid=0, token=b'', options=None,
+                 payload=b''):
+        self.mtype = mtype
+        self.code = code
+        self.mid = mid
+        self.token = token
+        self.options = options or []
+        self.payload = payload
+
+    def opt(self, number):
+        return [value for n, value in self.options if n == number]
+
+    def opt_uint(self, number):
+        values = self.opt(number)
+        if not values:
+            return None
+        return int.from_bytes(values[0], 'big')
+
+    def path(self):
+        return [p.decode() for p in self.opt(OPT_URI_PATH)]
+
+    def query(self):
+        query = {}
+        for q in self.opt(OPT_URI_QUERY):
+            key, _, value = q.decode().partition('=')
+            query[key] = value
+        return query
+
+    def encode(self):
+        out = struct.pack('!BBH', (VERSION << 6) | (self.mtype << 4) |
+                          len(self.token), self.code, self.mid) + self.token
+        last = 0
+        for number, value in sorted(self.options, key=lambda o: o[0]):
+            delta, delta_ext = encode_ext(number - last)
+            length, length_ext = encode_ext(len(value))
+            out += bytes([(delta << 4) | length]) + delta_ext + length_ext
+            out += value
+            last = number
+        if self.payload:
+            out += b'\xff' + self.payload
+        return out
+
+    @staticmethod
+    def decode(data):
+        if len(data) < 4 or data[0] >> 6 != VERSION:
+            return None
+        tkl = data[0] & 0xf
+        msg = Message((data[0] >> 4) & 0x3, data[1],
+                      struct.unpack('!H', data[2:4])[0], data[4:4 + tkl])
+        pos = 4 + tkl
+        number = 0
+        while pos < len(data):
+            if data[pos] == 0xff:
+                msg.payload = data[pos + 1:]
+                break
+            fields = [data[pos] >> 4, data[pos] & 0xf]
+            pos += 1
+            for i in range(2):
+                if fields[i] == 13:
+                    fields[i] = data[pos] + 13
+                    pos += 1
+                elif fields[i] == 14:
+                    fields[i] = struct.unpack('!H', data[pos:pos + 2])[0] + 269
+                    pos += 2
+            number += fields[0]
+            msg.options.append((number, data[pos:pos + fields[1]]))
+            pos += fields[1]
+        return msg
@@ -0,0 +1,600 @@
+# Copyright (c) 2019 Foundries.io
+#
+# SPDX-License-Identifier: Apache-2.0
+
+# Run a fleet of native_posix instances of the application against one
+# LwM2M server, drive them through a scenario and report fleet-level
+# metrics as JSON.
+#
+# Scenarios:
+#   boot            start every instance at once (or over --spread
+#                   seconds) and wait until all of them registered
+#   server-restart  boot, then stop the server for --downtime seconds
+#                   and measure how the fleet comes back
+#   fota            boot, then update every instance with --image
+#                   (at most --parallel at a time) and wait until they
+#                   are back with the update result
+#   group           boot, multicast --image to every instance with
+#                   scripts/group_fota.py, leaving out --drop of the
+#                   blocks so that they get repaired, then update every
+#                   instance from it and wait for the update result.
+#                   Needs a build with overlay-group.conf.
+#
+# Each instance runs in its own network namespace, "fleet<n>", with the
+# zeth TAP interface the native_posix build expects. The namespace
+# answers for the server address in boards/native_posix.conf
+# (2001:db8::2), and forwards CoAP to the real server over a veth pair,
+# NATed so that the server sees every instance at its own address,
+# fd00:0:0:<n>::2. Setting this up needs root, iproute2 and nftables.
+#
+# Instance <n> is started with --serial=<n>, so its endpoint is
+# <prefix>:sn:<hash of n> (see src/lib/product_id.c), and with its own
+# --flash file in --workdir, which keeps its settings across reboots.
+# When an instance exits (a reboot), it is started again.
+#
+# The namespaces share no link, so in the group scenario each gets its
+# own group_fota.py, multicasting on its zeth interface from the server
+# address; the instance then asks it for the blocks it missed.
+#
+# Unless --hostname is given, scripts/lwm2m_local_server.py is started
+# on the host, and its CPU time is part of the report.
+
+import argparse
+import concurrent.futures
+import json
+import logging
+import os
+import re
+import shutil
+import signal
+import subprocess
+import sys
+import threading
+import time
+import urllib.request
+
+SERVER_ADDR = '2001:db8::2'
+COAP_PORT = 5683
+
+LOCAL_SERVER = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                            'lwm2m_local_server.py')
+GROUP_SENDER = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                            'group_fota.py')
+
+# device log lines counted per instance
+LOG_PATTERNS = {
+    'reconnects': re.compile(r'Reconnect attempt \d+'),
+    'reboots': re.compile(r'Rebooting device'),
+    'update_ok': re.compile(r'Firmware updated successfully'),
+    'update_failed': re.compile(r'Firmware failed to be updated'),
+    'group_complete': re.compile(r'Group firmware transfer complete'),
+    'group_aborted': re.compile(r'Group firmware transfer aborted'),
+}
+GROUP_REPAIRS = re.compile(r'Done, (\d+) block\(s\) repaired')
+
+logging.basicConfig(level=logging.INFO,
+                    format='%(asctime)s [%(levelname)s] %(message)s')
+
+
+def endpoint_name(prefix, serial):
+    # same as product_id_init(): hash of the serial number in hex
+    h = 0
+    for c in '%08x' % serial:
+        h = (h * 37 + ord(c)) & 0xffffffff
+    return '%s:sn:%08x' % (prefix, h)
+
+
+def run(*cmd, netns=None, stdin=None):
+    if netns:
+        cmd = ('ip', 'netns', 'exec', netns) + cmd
+    subprocess.run(cmd, check=True, input=stdin, universal_newlines=True,
+                   stdout=subprocess.DEVNULL)
+
+
+def cpu_seconds(pid):
+    with open('/proc/%d/stat' % pid) as f:
+        fields = f.read().rsplit(')', 1)[1].split()
+    # utime and stime, fields 14 and 15 of proc(5)
+    return (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+
+
+def percentiles(values):
+    if not values:
+        return None
+    values = sorted(values)
+
+    def pick(p):
+        return values[min(len(values) - 1, int(p * len(values)))]
+
+    return {'count': len(values), 'min': values[0], 'p50': pick(0.5),
+            'p90': pick(0.9), 'p99': pick(0.99), 'max': values[-1],
+            'mean': sum(values) / len(values)}
+
+
+class Network:
+    """Namespace, TAP and NAT plumbing for one instance."""
+
+    def __init__(self, index):
+        self.index = index
+        self.netns = 'fleet%d' % index
+        self.host_if = 'fleet%d' % index
+        self.prefix = 'fd00:0:0:%x::' % index
+
+    @property
+    def host_addr(self):
+        return self.prefix + '1'
+
+    @property
+    def addr(self):
+        return self.prefix + '2'
+
+    def setup(self):
+        self.teardown()
+        run('ip', 'netns', 'add', self.netns)
+        ns = self.netns
+        run('ip', 'link', 'add', self.host_if, 'type', 'veth',
+            'peer', 'name', 'veth0', 'netns', ns)
+        run('ip', 'addr', 'add', self.host_addr + '/64', 'dev',
+            self.host_if, 'nodad')
+        run('ip', 'link', 'set', self.host_if, 'up')
+
+        run('sysctl', '-q', 'net.ipv6.conf.all.forwarding=1', netns=ns)
+        run('ip', 'link', 'set', 'lo', 'up', netns=ns)
+        run('ip', 'addr', 'add', self.addr + '/64', 'dev', 'veth0', 'nodad',
+            netns=ns)
+        run('ip', 'link', 'set', 'veth0', 'up', netns=ns)
+        run('ip', '-6', 'route', 'add', 'default', 'via', self.host_addr,
+            netns=ns)
+        # persistent, so that it survives the instance "rebooting"
+        run('ip', 'tuntap', 'add', 'dev', 'zeth', 'mode', 'tap', netns=ns)
+        run('ip', 'addr', 'add', SERVER_ADDR + '/64', 'dev', 'zeth', 'nodad',
+            netns=ns)
+        run('ip', 'link', 'set', 'zeth', 'up', netns=ns)
+        run('nft', '-f', '-', netns=ns, stdin='''
+table ip6 fleet {
+    chain prerouting {
+        type nat hook prerouting priority -100;
+        iifname "zeth" ip6 daddr %s udp dport %d dnat to %s
+    }
+    chain postrouting {
+        type nat hook postrouting priority 100;
+        oifname "veth0" masquerade
+    }
+}
+''' % (SERVER_ADDR, COAP_PORT, self.host_addr))
+
+    def teardown(self):
+        subprocess.run(['ip', 'netns', 'del', self.netns],
+                       stderr=subprocess.DEVNULL)
+        subprocess.run(['ip', 'link', 'del', self.host_if],
+                       stderr=subprocess.DEVNULL)
+
+
+class Instance:
+    def __init__(self, index, args):
+        self.index = index
+        self.serial = index + 1
+        self.endpoint = endpoint_name(args.prefix, self.serial)
+        self.net = Network(index)
+        self.exe = os.path.abspath(args.exe)
+        self.flash = os.path.join(args.workdir, 'flash%d.bin' % index)
+        self.log = os.path.join(args.workdir, 'device%d.log' % index)
+        self.proc = None
+        self.running = False
+        self.boots = []
+        self.counts = dict((name, 0) for name in LOG_PATTERNS)
+        self.lock = threading.Lock()
+
+    def start(self):
+        self.running = True
+        threading.Thread(target=self.supervise, daemon=True).start()
+
+    def supervise(self):
+        with open(self.log, 'a') as log:
+            while self.running:
+                with self.lock:
+                    self.boots.append(time.time())
+                self.proc = subprocess.Popen(
+                    ['ip', 'netns', 'exec', self.net.netns, self.exe,
+                     '--serial=%d' % self.serial, '--flash=' + self.flash],
+                    stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                    universal_newlines=True, errors='replace')
+                for line in self.proc.stdout:
+                    log.write(line)
+                    for name, pattern in LOG_PATTERNS.items():
+                        if pattern.search(line):
+                            with self.lock:
+                                self.counts[name] += 1
+                self.proc.wait()
+                log.write('--- exited with %d ---\n' % self.proc.returncode)
+                log.flush()
+
+    def stop(self):
+        self.running = False
+        if self.proc and self.proc.poll() is None:
+            self.proc.terminate()
+            try:
+                self.proc.wait(5)
+            except subprocess.TimeoutExpired:
+                self.proc.kill()
+
+
+class Server:
+    """The LwM2M server: its REST API, its events and its CPU use."""
+
+    def __init__(self, args):
+        self.args = args
+        self.hostname = args.hostname
+        self.proc = None
+        self.pid = args.server_pid
+        self.listener = None
+        self.cpu = 0.0
+        self.lock = threading.Lock()
+        self.registrations = {}
+        self.events = []
+
+    def start(self):
+        if not self.hostname:
+            cmd = [sys.executable, LOCAL_SERVER, '-w', str(self.args.http_port),
+                   '--http-host', '127.0.0.1']
+            if self.args.image:
+                cmd += ['-f', os.path.dirname(os.path.abspath(self.args.image))]
+            with open(os.path.join(self.args.workdir, 'server.log'),
+                      'a') as log:
+                self.proc = subprocess.Popen(cmd, stdout=log,
+                                             stderr=subprocess.STDOUT)
+            self.pid = self.proc.pid
+            self.url = 'http://127.0.0.1:%d' % self.args.http_port
+            self.wait_ready()
+        else:
+            self.url = self.hostname
+        if not self.listener:
+            self.listener = threading.Thread(target=self.listen, daemon=True)
+            self.listener.start()
+
+    def stop(self):
+        if self.proc:
+            self.cpu += self.cpu_seconds()
+            self.proc.terminate()
+            self.proc.wait()
+            self.proc = None
+            self.pid = None
+
+    def cpu_seconds(self):
+        if not self.pid:
+            return 0.0
+        try:
+            return cpu_seconds(self.pid)
+        except OSError:
+            return 0.0
+
+    def total_cpu(self):
+        return self.cpu + self.cpu_seconds()
+
+    def wait_ready(self):
+        deadline = time.time() + 10
+        while time.time() < deadline:
+            try:
+                urllib.request.urlopen(self.url + '/api/clients', timeout=1)
+                return
+            except OSError:
+                time.sleep(0.1)
+        raise RuntimeError('LwM2M server did not start')
+
+    def listen(self):
+        # follow /event; reconnect when the server restarts
+        while True:
+            try:
+                stream = urllib.request.urlopen(self.url + '/event')
+                name = None
+                for raw in stream:
+                    line = raw.decode().rstrip('\n')
+                    if line.startswith('event:'):
+                        name = line[6:].strip()
+                    elif line.startswith('data:') and name:
+                        self.event(name, json.loads(line[5:]))
+                        name = None
+            except Exception:
+                pass
+            time.sleep(0.5)
+
+    def event(self, name, data):
+        now = time.time()
+        endpoint = data.get('endpoint', data.get('ep'))
+        with self.lock:
+            self.events.append((now, name, endpoint))
+            if name == 'REGISTRATION':
+                self.registrations.setdefault(endpoint, []).append(now)
+
+    def registered_since(self, endpoint, since):
+        with self.lock:
+            times = self.registrations.get(endpoint, [])
+            return next((t for t in times if t >= since), None)
+
+    def request(self, method, path, data=None):
+        body = json.dumps(data).encode() if data is not None else None
+        req = urllib.request.Request(self.url + path, data=body,
+                                     method=method,
+                                     headers={'Content-Type':
+                                              'application/json'})
+        with urllib.request.urlopen(req, timeout=120) as response:
+            return json.loads(response.read().decode() or 'null')
+
+
+class Fleet:
+    def __init__(self, args):
+        self.args = args
+        self.server = Server(args)
+        self.instances = [Instance(i, args) for i in range(args.count)]
+        self.results = {'scenario': args.scenario, 'count': args.count}
+
+    def setup(self):
+        os.makedirs(self.args.workdir, exist_ok=True)
+        logging.info('Setting up %d network namespaces', len(self.instances))
+        for instance in self.instances:
+            instance.net.setup()
+        self.server.start()
+
+    def teardown(self):
+        for instance in self.instances:
+            instance.stop()
+        self.server.stop()
+        for instance in self.instances:
+            instance.net.teardown()
+
+    def boot(self, name):
+        start = time.time()
+        cpu = self.server.total_cpu()
+        spread = self.args.spread / max(1, len(self.instances))
+        for instance in self.instances:
+            instance.start()
+            if spread:
+                time.sleep(spread)
+        self.wait_registered(name, start, cpu)
+
+    def wait_registered(self, name, since, cpu, instances=None):
+        instances = instances or self.instances
+        deadline = time.time() + self.args.timeout
+        pending = set(instances)
+        times = {}
+        while pending and time.time() < deadline:
+            for instance in list(pending):
+                t = self.server.registered_since(instance.endpoint, since)
+                if t:
+                    times[instance.endpoint] = t - max(since,
+                                                       instance.boots[0])
+                    pending.remove(instance)
+            time.sleep(0.2)
+        elapsed = time.time() - since
+        server_cpu = self.server.total_cpu() - cpu
+        self.results[name] = {
+            'registered': len(times),
+            'missing': sorted(i.endpoint for i in pending),
+            'registration_s': percentiles(list(times.values())),
+            'elapsed_s': elapsed,
+            'server_cpu_s': server_cpu,
+            'server_cpu_pct': 100 * server_cpu / elapsed if elapsed else 0,
+        }
+        logging.info('%s: %d/%d registered in %.1f s', name, len(times),
+                     len(instances), elapsed)
+        return times
+
+    def server_restart(self):
+        self.boot('boot')
+        if not self.server.proc:
+            raise RuntimeError('server-restart needs the local server')
+        logging.info('Stopping the server for %d s', self.args.downtime)
+        self.server.stop()
+        time.sleep(self.args.downtime)
+        start = time.time()
+        cpu = self.server.total_cpu()
+        self.server.start()
+        self.wait_registered('restart', start, cpu)
+
+    def fota(self):
+        self.boot('boot')
+        name = os.path.basename(self.args.image)
+        package_uri = self.args.package_uri or \
+            'coap://[%s]:%d/fw/%s' % (SERVER_ADDR, COAP_PORT, name)
+        start = time.time()
+        cpu = self.server.total_cpu()
+        with concurrent.futures.ThreadPoolExecutor(self.args.parallel) as pool:
+            updates = list(pool.map(lambda i: self.update(i, package_uri),
+                                    self.instances))
+        elapsed = time.time() - start
+        server_cpu = self.server.total_cpu() - cpu
+        done = [u for u in updates if u.get('result') == 1]
+        self.results['fota'] = {
+            'updated': len(done),
+            'failed': dict((u['endpoint'], u.get('result', u.get('error')))
+                           for u in updates if u.get('result') != 1),
+            'download_s': percentiles([u['download_s'] for u in done]),
+            'update_s': percentiles([u['update_s'] for u in done]),
+            'elapsed_s': elapsed,
+            'server_cpu_s': server_cpu,
+            'server_cpu_pct': 100 * server_cpu / elapsed if elapsed else 0,
+        }
+        logging.info('fota: %d/%d updated in %.1f s', len(done),
+                     len(updates), elapsed)
+
+    def group(self):
+        self.boot('boot')
+        start = time.time()
+        with concurrent.futures.ThreadPoolExecutor(self.args.parallel) as pool:
+            updates = list(pool.map(self.group_update, self.instances))
+        elapsed = time.time() - start
+        done = [u for u in updates if u.get('result') == 1]
+        self.results['group'] = {
+            'updated': len(done),
+            'failed': dict((u['endpoint'], u.get('result', u.get('error')))
+                           for u in updates if u.get('result') != 1),
+            'download_s': percentiles([u['download_s'] for u in done]),
+            'repairs': percentiles([u['repairs'] for u in done
+                                    if u.get('repairs') is not None]),
+            'update_s': percentiles([u['update_s'] for u in done]),
+            'elapsed_s': elapsed,
+        }
+        logging.info('group: %d/%d updated in %.1f s', len(done),
+                     len(updates), elapsed)
+
+    def read(self, instance, path):
+        data = self.server.request('GET', '/api/clients/%s/%s' %
+                                   (instance.endpoint, path))
+        if not data or not data.get('success'):
+            return None
+        return data['content'].get('value')
+
+    def wait_state(self, instance, state, deadline):
+        while self.read(instance, '5/0/3') != state:
+            if time.time() > deadline:
+                raise TimeoutError('state %d' % state)
+            time.sleep(self.args.poll)
+
+    def apply(self, instance, result, deadline):
+        start = time.time()
+        self.server.request('POST', '/api/clients/%s/5/0/2' %
+                            instance.endpoint)
+        while not self.server.registered_since(instance.endpoint, start):
+            if time.time() > deadline:
+                raise TimeoutError('reboot')
+            time.sleep(self.args.poll)
+        result['update_s'] = time.time() - start
+        result['result'] = self.read(instance, '5/0/5')
+
+    def update(self, instance, package_uri):
+        result = {'endpoint': instance.endpoint}
+        deadline = time.time() + self.args.timeout
+        try:
+            start = time.time()
+            self.server.request('PUT', '/api/clients/%s/5/0/1' %
+                                instance.endpoint,
+                                {'id': 1, 'value': package_uri})
+            # state 2: downloaded
+            self.wait_state(instance, 2, deadline)
+            result['download_s'] = time.time() - start
+            self.apply(instance, result, deadline)
+        except Exception as e:
+            result['error'] = str(e)
+            logging.warning('%s: update failed: %s', instance.endpoint, e)
+        return result
+
+    def group_update(self, instance):
+        result = {'endpoint': instance.endpoint}
+        deadline = time.time() + self.args.timeout
+        log = os.path.join(self.args.workdir, 'group%d.log' % instance.index)
+        sender = None
+        try:
+            start = time.time()
+            with open(log, 'w') as out:
+                sender = subprocess.Popen(
+                    ['ip', 'netns', 'exec', instance.net.netns,
+                     sys.executable, GROUP_SENDER, self.args.image,
+                     '--iface', 'zeth', '--drop', str(self.args.drop),
+                     '--linger', str(self.args.linger)],
+                    stdout=out, stderr=subprocess.STDOUT)
+            self.wait_state(instance, 2, deadline)
+            result['download_s'] = time.time() - start
+            sender.wait(max(1, deadline - time.time()))
+            with open(log) as out:
+                match = GROUP_REPAIRS.search(out.read())
+            result['repairs'] = int(match.group(1)) if match else None
+            self.apply(instance, result, deadline)
+        except Exception as e:
+            result['error'] = str(e)
+            logging.warning('%s: group update failed: %s',
+                            instance.endpoint, e)
+            if sender and sender.poll() is None:
+                sender.kill()
+        return result
+
+    def report(self):
+        counts = dict((name, [i.counts[name] for i in self.instances])
+                      for name in LOG_PATTERNS)
+        self.results['devices'] = dict(
+            (name, {'total': sum(values), 'max': max(values)})
+            for name, values in counts.items())
+        self.results['boots'] = sum(len(i.boots) for i in self.instances)
+        with self.server.lock:
+            events = [name for _, name, _ in self.server.events]
+        self.results['server_events'] = dict(
+            (name, events.count(name)) for name in set(events))
+        return self.results
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run a fleet of native_posix instances against one '
+                    'LwM2M server')
+    parser.add_argument('exe', help='native_posix build (zephyr.exe)')
+    parser.add_argument('-n', '--count', type=int, default=10,
+                        help='number of instances')
+    parser.add_argument('-s', '--scenario', default='boot',
+                        choices=['boot', 'server-restart', 'fota', 'group'])
+    parser.add_argument('-w', '--workdir', default='fleet',
+                        help='flash files and logs go here')
+    parser.add_argument('--fresh', action='store_true',
+                        help='start from erased flash files')
+    parser.add_argument('--prefix', default='zmp',
+                        help='CONFIG_FOTA_ENDPOINT_PREFIX')
+    parser.add_argument('-host', '--hostname',
+                        help='REST API of an already running server')
+    parser.add_argument('--server-pid', type=int,
+                        help='pid of that server, to measure its CPU use')
+    parser.add_argument('--http-port', type=int, default=8080,
+                        help='REST API port of the local server')
+    parser.add_argument('--spread', type=float, default=0,
+                        help='seconds over which to start the instances')
+    parser.add_argument('--downtime', type=int, default=30,
+                        help='server-restart: seconds the server is down')
+    parser.add_argument('-i', '--image',
+                        help='fota, group: signed image to send')
+    parser.add_argument('--package-uri',
+                        help='fota: Package URI, if not served locally')
+    parser.add_argument('-p', '--parallel', type=int, default=50,
+                        help='fota, group: devices updated at the same time')
+    parser.add_argument('--poll', type=float, default=2,
+                        help='fota, group: seconds between state reads')
+    parser.add_argument('--drop', type=float, default=0.1,
+                        help='group: share of blocks left out of the '
+                             'multicast')
+    parser.add_argument('--linger', type=float, default=15,
+                        help='group: seconds the sender keeps serving '
+                             'repairs once idle')
+    parser.add_argument('-t', '--timeout', type=int, default=600,
+                        help='seconds to wait for the fleet in each step')
+    parser.add_argument('-o', '--output', help='write the report here')
+    args = parser.parse_args()
+
+    if args.scenario == 'fota' and not args.image and not args.package_uri:
+        parser.error('fota needs --image or --package-uri')
+    if args.scenario == 'group' and not args.image:
+        parser.error('group needs --image')
+    if os.geteuid() != 0:
+        parser.error('must run as root, to set up the network namespaces')
+    if args.fresh and os.path.isdir(args.workdir):
+        shutil.rmtree(args.workdir)
+
+    fleet = Fleet(args)
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(1))
+    try:
+        fleet.setup()
+        if args.scenario == 'boot':
+            fleet.boot('boot')
+        elif args.scenario == 'server-restart':
+            fleet.server_restart()
+        elif args.scenario == 'group':
+            fleet.group()
+        else:
+            fleet.fota()
+    finally:
+        fleet.teardown()
+
+    report = json.dumps(fleet.report(), indent=2, sort_keys=True)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(report + '\n')
+    print(report)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,335 @@
+# Copyright (c) 2019 Foundries.io
+#
+# SPDX-License-Identifier: Apache-2.0
+
+# Firmware updates for a whole fleet from one process.
+#
+# Like leshan.py, but event driven: instead of a thread per device
+# polling 5/0/3 and 5/0/5, one coroutine per device observes them and
+# waits for the server's notifications, all of which arrive on a single
+# /event stream. Requests share a pool of keep-alive connections, and at
+# most --parallel devices are being updated at any time.
+#
+# A slow read every --fallback seconds covers lost notifications.
+#
+# Needs aiohttp (pip3 install aiohttp).
+
+import argparse
+import asyncio
+import json
+import logging
+import signal
+import sys
+import time
+
+import aiohttp
+
+# Firmware Update object (5/0) resources and states
+STATE = 3
+RESULT = 5
+STATE_IDLE = 0
+STATE_DOWNLOADING = 1
+STATE_DOWNLOADED = 2
+RESULT_SUCCESS = 1
+
+logging.basicConfig(level=logging.INFO,
+                    format='%(asctime)s [%(levelname)s] %(message)s')
+
+
+class Server:
+    """Leshan REST API, over one connection pool."""
+
+    def __init__(self, hostname, content_format, connections):
+        self.hostname = hostname
+        self.content_format = content_format
+        self.session = aiohttp.ClientSession(
+            connector=aiohttp.TCPConnector(limit=connections),
+            timeout=aiohttp.ClientTimeout(total=None, sock_connect=30))
+        self.request_timeout = aiohttp.ClientTimeout(total=120)
+        self.devices = {}
+
+    async def close(self):
+        await self.session.close()
+
+    def url(self, endpoint, path=''):
+        url = '%s/api/clients' % self.hostname
+        if endpoint:
+            url += '/' + endpoint
+        if path:
+            url += '/' + path
+        return url
+
+    async def request(self, method, url, data=None):
+        async with self.session.request(
+                method, url, json=data, timeout=self.request_timeout,
+                params={'format': self.content_format}) as response:
+            if response.status not in (200, 201):
+                raise RuntimeError('%s %s: HTTP %d' %
+                                   (method, url, response.status))
+            payload = await response.json(content_type=None)
+        # Leshan reports device side failures in the payload
+        if isinstance(payload, dict) and payload.get('failure'):
+            raise RuntimeError('%s %s: %s' % (method, url,
+                                              payload.get('status')))
+        return payload
+
+    async def clients(self):
+        return await self.request('GET', self.url(None))
+
+    async def read(self, endpoint, path):
+        payload = await self.request('GET', self.url(endpoint, path))
+        return payload['content'].get('value')
+
+    async def write(self, endpoint, path, value):
+        resource = int(path.rsplit('/', 1)[1])
+        await self.request('PUT', self.url(endpoint, path),
+                           {'id': resource, 'value': value})
+
+    async def execute(self, endpoint, path):
+        await self.request('POST', self.url(endpoint, path))
+
+    async def observe(self, endpoint, path):
+        payload = await self.request('POST',
+                                     self.url(endpoint, path + '/observe'))
+        return payload['content'].get('value')
+
+    async def events(self):
+        """Dispatch /event to the devices being updated, forever."""
+        while True:
+            try:
+                async with self.session.get(self.hostname + '/event') as sse:
+                    logging.debug('listening to server events')
+                    name = None
+                    async for raw in sse.content:
+                        line = raw.decode().rstrip('\r\n')
+                        if line.startswith('event:'):
+                            name = line[6:].strip()
+                        elif line.startswith('data:') and name:
+                            self.dispatch(name, json.loads(line[5:]))
+                            name = None
+            except (aiohttp.ClientError, ValueError) as e:
+                logging.warning('event stream: %s', e)
+            await asyncio.sleep(1)
+
+    def dispatch(self, name, data):
+        device = self.devices.get(data.get('ep', data.get('endpoint')))
+        if not device:
+            return
+        if name == 'NOTIFICATION':
+            path = data.get('res', '').strip('/').split('/')
+            value = data.get('val', {}).get('value')
+            if path[:2] == ['5', '0'] and len(path) == 3:
+                device.notify(int(path[2]), value)
+        elif name == 'REGISTRATION':
+            device.registered.set()
+
+
+class Device:
+    def __init__(self, server, endpoint, args):
+        self.server = server
+        self.endpoint = endpoint
+        self.args = args
+        self.values = {}
+        self.changed = asyncio.Event()
+        self.registered = asyncio.Event()
+        self.download_s = None
+        self.update_s = None
+        self.result = None
+        self.error = None
+
+    def notify(self, resource, value):
+        self.values[resource] = value
+        self.changed.set()
+
+    async def wait_for(self, done, timeout):
+        """Wait until done(values) holds, on notifications."""
+        deadline = time.monotonic() + timeout
+        while not done(self.values):
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                raise asyncio.TimeoutError()
+            self.changed.clear()
+            try:
+                await asyncio.wait_for(self.changed.wait(),
+                                       min(remaining, self.args.fallback))
+            except asyncio.TimeoutError:
+                # no notification for a while: read, in case one was lost
+                for resource in (STATE, RESULT):
+                    self.values[resource] = await self.server.read(
+                        self.endpoint, '5/0/%d' % resource)
+
+    async def observe(self):
+        for resource in (STATE, RESULT):
+            self.values[resource] = await self.server.observe(
+                self.endpoint, '5/0/%d' % resource)
+
+    async def download(self):
+        start = time.monotonic()
+        await self.observe()
+        if self.values[STATE] != STATE_IDLE:
+            raise RuntimeError('not idle (state %s)' % self.values[STATE])
+        await self.server.write(self.endpoint, '5/0/1', self.args.url)
+        logging.info('[%s] requested download', self.endpoint)
+        # a result left over from the previous attempt is no failure
+        self.values.pop(RESULT, None)
+        started = False
+
+        def downloaded(values):
+            nonlocal started
+            if values.get(STATE) == STATE_DOWNLOADING:
+                started = True
+            if started and values.get(STATE) == STATE_IDLE and \
+               values.get(RESULT, 0) > RESULT_SUCCESS:
+                raise RuntimeError('download failed (%d)' % values[RESULT])
+            return values.get(STATE) == STATE_DOWNLOADED
+
+        await self.wait_for(downloaded, self.args.download_timeout)
+        self.download_s = time.monotonic() - start
+        logging.info('[%s] downloaded in %.1f s', self.endpoint,
+                     self.download_s)
+
+    async def update(self):
+        start = time.monotonic()
+        self.registered.clear()
+        await self.server.execute(self.endpoint, '5/0/2')
+        logging.info('[%s] requested update', self.endpoint)
+        # the device reboots, and registers again with the result set
+        await asyncio.wait_for(self.registered.wait(),
+                               self.args.update_timeout)
+        for _ in range(5):
+            self.result = await self.server.read(self.endpoint, '5/0/5')
+            if self.result:
+                break
+            await asyncio.sleep(2)
+        self.update_s = time.monotonic() - start
+        if self.result != RESULT_SUCCESS:
+            raise RuntimeError('update failed (%s)' % self.result)
+        logging.info('[%s] updated in %.1f s', self.endpoint, self.update_s)
+
+    async def run(self, slots):
+        async with slots:
+            try:
+                await self.download()
+                if not self.args.download_only:
+                    await self.update()
+            except asyncio.TimeoutError:
+                self.error = 'timeout'
+            except (aiohttp.ClientError, RuntimeError) as e:
+                self.error = str(e)
+            if self.error:
+                logging.error('[%s] %s', self.endpoint, self.error)
+
+    def report(self):
+        return {'endpoint': self.endpoint, 'download_s': self.download_s,
+                'update_s': self.update_s, 'result': self.result,
+                'error': self.error}
+
+
+async def select_targets(server, args):
+    targets = []
+    for target in await server.clients():
+        endpoint = target.get('endpoint')
+        if not endpoint:
+            continue
+        if args.client and args.client not in endpoint:
+            continue
+        targets.append(endpoint)
+    if not args.device:
+        return targets
+
+    slots = asyncio.Semaphore(args.parallel)
+
+    async def model(endpoint):
+        async with slots:
+            try:
+                return await server.read(endpoint, '3/0/1')
+            except (aiohttp.ClientError, RuntimeError):
+                return None
+
+    models = await asyncio.gather(*(model(t) for t in targets))
+    return [t for t, m in zip(targets, models) if m == args.device]
+
+
+async def run(args):
+    server = Server(args.hostname, args.format, args.connections)
+    events = asyncio.ensure_future(server.events())
+    try:
+        targets = await select_targets(server, args)
+        logging.info('updating %d device(s), %d at a time', len(targets),
+                     args.parallel)
+        devices = [Device(server, endpoint, args) for endpoint in targets]
+        server.devices = dict((d.endpoint, d) for d in devices)
+        # let the event stream connect before anything can happen
+        await asyncio.sleep(1)
+
+        start = time.monotonic()
+        slots = asyncio.Semaphore(args.parallel)
+        await asyncio.gather(*(d.run(slots) for d in devices))
+        elapsed = time.monotonic() - start
+    finally:
+        events.cancel()
+        await server.close()
+
+    failed = [d for d in devices if d.error]
+    logging.info('UPDATE SUMMARY:')
+    for d in devices:
+        if d.error:
+            logging.info('[%s] update FAILED: %s', d.endpoint, d.error)
+        else:
+            logging.info('[%s] update SUCCESS (download %.1f s, update %s)',
+                         d.endpoint, d.download_s,
+                         '%.1f s' % d.update_s if d.update_s else '-')
+    logging.info('%d update(s) attempted, %d failed, in %d seconds',
+                 len(devices), len(failed), elapsed)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump({'elapsed_s': elapsed,
+                       'devices': [d.report() for d in devices]},
+                      f, indent=2)
+            f.write('\n')
+    return 1 if failed else 0
+
+
+def main():
+    description = 'Event driven Leshan API wrapper for fleet firmware updates'
+    parser = argparse.ArgumentParser(description=description)
+    parser.add_argument('-u', '--url', required=True,
+                        help='URL for client firmware (http:// or coap://)')
+    parser.add_argument('-c', '--client', default=None,
+                        help='Leshan Client ID filter, all targets if unset')
+    parser.add_argument('-host', '--hostname',
+                        default='https://mgmt.foundries.io/leshan',
+                        help='Leshan server URL')
+    parser.add_argument('-d', '--device', default=None,
+                        help='Device type filter')
+    parser.add_argument('-p', '--parallel', type=int, default=100,
+                        help='devices updated at the same time')
+    parser.add_argument('--connections', type=int, default=20,
+                        help='HTTP connections to the server')
+    parser.add_argument('-f', '--format', default='TLV',
+                        help='Content format for reads')
+    parser.add_argument('--fallback', type=float, default=60,
+                        help='read the state after this many seconds '
+                             'without a notification')
+    parser.add_argument('--download-timeout', type=float, default=3600)
+    parser.add_argument('--update-timeout', type=float, default=600)
+    parser.add_argument('--download-only', action='store_true',
+                        help='do not trigger the updates')
+    parser.add_argument('-o', '--output',
+                        help='write per-device durations here, as JSON')
+    args = parser.parse_args()
+
+    loop = asyncio.new_event_loop()
+    asyncio.set_event_loop(loop)
+    task = loop.create_task(run(args))
+    loop.add_signal_handler(signal.SIGINT, task.cancel)
+    try:
+        sys.exit(loop.run_until_complete(task))
+    except asyncio.CancelledError:
+        print('Script aborted')
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,244 @@
+# Copyright (c) 2019 Foundries.io
+#
+# SPDX-License-Identifier: Apache-2.0
+
+# FOTA soak benchmark: run download, update, reboot and confirm cycles
+# on a native_posix build against a local server, and print one JSON
+# record per cycle:
+#
+#   {"cycle": 1, "bytes": ..., "download_ms": ..., "erase_ms": ...,
+#    "write_ms": ..., "boot_ms": ..., "result": 1, "wall_s": ...}
+#
+# The device side figures come from the CONFIG_FOTA_TIMING records in
+# its log (see src/fota_timing.h); boot_ms is the time from the reboot
+# into the new image to REGISTRATION_COMPLETE.
+#
+# The medians of the timings are compared to a --baseline file; the run
+# fails if a cycle fails or a median is more than --threshold (or the
+# baseline's own per-metric threshold) above the baseline. Write a
+# baseline with --save-baseline.
+#
+# The build must be reachable at the server address of
+# boards/native_posix.conf, 2001:db8::2, e.g. on the zeth interface set
+# up by Zephyr's net-setup.sh.
+
+import argparse
+import json
+import logging
+import os
+import queue
+import re
+import statistics
+import subprocess
+import sys
+import threading
+import time
+
+from fleet_sim import Server, SERVER_ADDR, COAP_PORT, endpoint_name
+
+TIMING = re.compile(r'fota_timing: (download|registered) (.*)$')
+METRICS = ['download_ms', 'erase_ms', 'write_ms', 'boot_ms']
+
+logging.basicConfig(level=logging.INFO,
+                    format='%(asctime)s [%(levelname)s] %(message)s')
+
+
+class Device:
+    """The native_posix process, started again when it reboots."""
+
+    def __init__(self, args):
+        self.cmd = [os.path.abspath(args.exe), '--serial=%d' % args.serial,
+                    '--flash=' + os.path.join(args.workdir, 'flash.bin')]
+        self.log = os.path.join(args.workdir, 'device.log')
+        self.records = queue.Queue()
+        self.proc = None
+        self.running = True
+        self.exits = 0
+
+    def start(self):
+        threading.Thread(target=self.supervise, daemon=True).start()
+
+    def supervise(self):
+        with open(self.log, 'a') as log:
+            while self.running:
+                self.proc = subprocess.Popen(
+                    self.cmd, stdout=subprocess.PIPE,
+                    stderr=subprocess.STDOUT, universal_newlines=True,
+                    errors='replace')
+                for line in self.proc.stdout:
+                    log.write(line)
+                    match = TIMING.search(line)
+                    if match:
+                        record = dict(item.split('=', 1)
+                                      for item in match.group(2).split())
+                        self.records.put((match.group(1), dict(
+                            (k, int(v)) for k, v in record.items())))
+                self.proc.wait()
+                self.exits += 1
+                log.write('--- exited with %d ---\n' % self.proc.returncode)
+                log.flush()
+
+    def stop(self):
+        self.running = False
+        if self.proc and self.proc.poll() is None:
+            self.proc.terminate()
+            self.proc.wait()
+
+    def wait(self, kind, timeout):
+        deadline = time.time() + timeout
+        while True:
+            remaining = deadline - time.time()
+            if remaining <= 0:
+                raise TimeoutError('no %s record' % kind)
+            try:
+                got, record = self.records.get(timeout=remaining)
+            except queue.Empty:
+                continue
+            if got == kind:
+                return record
+
+
+def cycle(number, args, server, device, endpoint, package_uri):
+    start = time.time()
+    server.request('PUT', '/api/clients/%s/5/0/1' % endpoint,
+                   {'id': 1, 'value': package_uri})
+    download = device.wait('download', args.timeout)
+
+    # the state changes after the last block is acknowledged
+    deadline = time.time() + args.timeout
+    while server.request('GET', '/api/clients/%s/5/0/3' %
+                         endpoint)['content'].get('value') != 2:
+        if time.time() > deadline:
+            raise TimeoutError('not in the downloaded state')
+        time.sleep(0.5)
+
+    server.request('POST', '/api/clients/%s/5/0/2' % endpoint)
+    boot = device.wait('registered', args.timeout)
+
+    record = {'cycle': number, 'bytes': download['bytes'],
+              'download_ms': download['ms'],
+              'erase_ms': download['erase_ms'],
+              'write_ms': download['write_ms'],
+              'boot_ms': boot['boot_ms'], 'result': boot['result'],
+              'wall_s': round(time.time() - start, 3)}
+    return record
+
+
+def compare(summary, baseline, threshold):
+    regressions = []
+    limits = baseline.get('thresholds', {})
+    for metric, reference in baseline.get('metrics', {}).items():
+        value = summary['metrics'].get(metric)
+        if value is None or not reference:
+            continue
+        limit = limits.get(metric, threshold)
+        change = (value - reference) / reference
+        status = 'REGRESSION' if change > limit else 'ok'
+        logging.info('%-12s %8.0f vs %8.0f (%+.0f%%, limit +%.0f%%) %s',
+                     metric, value, reference, 100 * change, 100 * limit,
+                     status)
+        if change > limit:
+            regressions.append(metric)
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='FOTA soak benchmark on a native_posix build')
+    parser.add_argument('exe', help='native_posix build (zephyr.exe)')
+    parser.add_argument('-i', '--image', required=True,
+                        help='signed image to update to, served locally')
+    parser.add_argument('-n', '--cycles', type=int, default=10)
+    parser.add_argument('--serial', type=int, default=1)
+    parser.add_argument('--prefix', default='zmp',
+                        help='CONFIG_FOTA_ENDPOINT_PREFIX')
+    parser.add_argument('-w', '--workdir', default='soak',
+                        help='flash file and logs go here')
+    parser.add_argument('--http-port', type=int, default=8080,
+                        help='REST API port of the local server')
+    parser.add_argument('-t', '--timeout', type=int, default=600,
+                        help='seconds to wait for each step')
+    parser.add_argument('-b', '--baseline', help='baseline to compare with')
+    parser.add_argument('--threshold', type=float, default=0.2,
+                        help='allowed increase over the baseline, 0.2: 20%%')
+    parser.add_argument('--save-baseline',
+                        help='write the medians of this run here')
+    parser.add_argument('-o', '--output',
+                        help='append the cycle records here, one per line')
+    args = parser.parse_args()
+
+    # the fleet_sim server always runs the local server here
+    args.hostname = None
+    args.server_pid = None
+    os.makedirs(args.workdir, exist_ok=True)
+
+    endpoint = endpoint_name(args.prefix, args.serial)
+    package_uri = 'coap://[%s]:%d/fw/%s' % (SERVER_ADDR, COAP_PORT,
+                                           os.path.basename(args.image))
+    server = Server(args)
+    device = Device(args)
+    records = []
+    failed = False
+    output = open(args.output, 'a') if args.output else None
+    try:
+        server.start()
+        device.start()
+        device.wait('registered', args.timeout)
+        logging.info('%s registered, starting %d cycles', endpoint,
+                     args.cycles)
+        for number in range(1, args.cycles + 1):
+            try:
+                record = cycle(number, args, server, device, endpoint,
+                               package_uri)
+            except (TimeoutError, OSError, KeyError) as e:
+                record = {'cycle': number, 'error': str(e)}
+            line = json.dumps(record, sort_keys=True)
+            print(line)
+            sys.stdout.flush()
+            if output:
+                output.write(line + '\n')
+                output.flush()
+            if record.get('result') != 1:
+                failed = True
+                logging.error('cycle %d failed', number)
+                if 'error' in record:
+                    break
+            records.append(record)
+    finally:
+        device.stop()
+        server.stop()
+        if output:
+            output.close()
+
+    good = [r for r in records if r.get('result') == 1]
+    summary = {'cycles': len(records), 'failed': len(records) - len(good),
+               'metrics': {}}
+    for metric in METRICS:
+        values = [r[metric] for r in good]
+        if values:
+            summary['metrics'][metric] = statistics.median(values)
+    if good:
+        ms = statistics.median(r['download_ms'] for r in good)
+        if ms:
+            summary['throughput_bps'] = good[0]['bytes'] * 1000 / ms
+    logging.info('summary: %s', json.dumps(summary, sort_keys=True))
+
+    if args.save_baseline:
+        with open(args.save_baseline, 'w') as f:
+            json.dump({'metrics': summary['metrics']}, f, indent=2,
+                      sort_keys=True)
+            f.write('\n')
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        regressions = compare(summary, baseline, args.threshold)
+        if regressions:
+            logging.error('regressed: %s', ', '.join(regressions))
+            failed = True
+
+    sys.exit(1 if failed or not good else 0)
+
+
+if __name__ == '__main__':
+    main()
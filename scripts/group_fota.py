@@ -0,0 +1,156 @@
+# Copyright (c) 2019 Foundries.io
+#
+# SPDX-License-Identifier: Apache-2.0
+
+# Multicast a firmware image to a group of devices running with
+# CONFIG_FOTA_GROUP, then answer their unicast requests for missed blocks.
+#
+# Each block goes out once as a non-confirmable CoAP PUT to /fw with
+# Block1 and Size1 options. Devices ask for gaps with a confirmable GET
+# to /fw carrying Block2 and the transfer token. --drop leaves out a
+# share of the blocks from the multicast, to exercise those repairs.
+#
+# The "group" scenario of fleet_sim.py runs this against several
+# native_posix instances.
+
+import argparse
+import logging
+import os
+import random
+import select
+import socket
+import time
+
+from coap import (ACK, CON, CONTENT, GET, NON, NOT_FOUND, OPT_BLOCK1,
+                  OPT_BLOCK2, OPT_SIZE1, OPT_URI_PATH, PUT, Message,
+                  block_fields, block_option, block_szx, encode_uint)
+
+FW_PATH = 'fw'
+
+logging.basicConfig(level=logging.INFO,
+                    format='[%(levelname)s] %(message)s')
+
+
+class GroupSender:
+    def __init__(self, image, group, port, iface, block_size, interval,
+                 drop=0):
+        self.image = image
+        self.group = group
+        self.port = port
+        self.block_size = block_size
+        self.szx = block_szx(block_size)
+        self.interval = interval
+        self.drop = drop
+        self.block_count = (len(image) + block_size - 1) // block_size
+        self.token = os.urandom(4)
+        self.msg_id = int.from_bytes(os.urandom(2), 'big')
+        self.repairs = 0
+
+        self.sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+        self.sock.bind(('::', 0))
+        if iface:
+            index = socket.if_nametoindex(iface)
+            self.sock.setsockopt(socket.IPPROTO_IPV6,
+                                 socket.IPV6_MULTICAST_IF, index)
+        self.sock.setsockopt(socket.IPPROTO_IPV6,
+                             socket.IPV6_MULTICAST_HOPS, 8)
+
+    def next_id(self):
+        self.msg_id = (self.msg_id + 1) & 0xffff
+        return self.msg_id
+
+    def block(self, num):
+        return self.image[num * self.block_size:(num + 1) * self.block_size]
+
+    def multicast(self):
+        logging.info('Sending %d bytes as %d blocks of %d to [%s]:%d',
+                     len(self.image), self.block_count, self.block_size,
+                     self.group, self.port)
+        start = time.time()
+        dropped = 0
+        for num in range(self.block_count):
+            if random.random() < self.drop:
+                dropped += 1
+                continue
+            more = num < self.block_count - 1
+            options = [(OPT_URI_PATH, FW_PATH.encode()),
+                       (OPT_BLOCK1, block_option(num, more, self.szx)),
+                       (OPT_SIZE1, encode_uint(len(self.image)))]
+            packet = Message(NON, PUT, self.next_id(), self.token, options,
+                             self.block(num))
+            self.sock.sendto(packet.encode(), (self.group, self.port))
+            # serve repairs which arrive while still multicasting
+            self.serve(self.interval)
+        logging.info('Multicast done in %.1f s, %d block(s) left out',
+                     time.time() - start, dropped)
+
+    def serve(self, duration):
+        deadline = time.time() + duration
+        while True:
+            remaining = deadline - time.time()
+            if remaining <= 0:
+                return
+            readable, _, _ = select.select([self.sock], [], [], remaining)
+            if not readable:
+                return
+            data, addr = self.sock.recvfrom(2048)
+            self.handle_repair(data, addr)
+            # keep serving repairs for the whole linger period
+            if duration > self.interval:
+                deadline = max(deadline, time.time() + duration)
+
+    def handle_repair(self, data, addr):
+        msg = Message.decode(data)
+        if not msg or msg.code != GET or msg.token != self.token:
+            return
+
+        reply_type = ACK if msg.mtype == CON else NON
+        reply_id = msg.mid if msg.mtype == CON else self.next_id()
+        num, _, _ = block_fields(msg.opt_uint(OPT_BLOCK2) or 0)
+        if '/'.join(msg.path()) != FW_PATH or num >= self.block_count:
+            packet = Message(reply_type, NOT_FOUND, reply_id, msg.token)
+        else:
+            more = num < self.block_count - 1
+            packet = Message(reply_type, CONTENT, reply_id, msg.token,
+                             [(OPT_BLOCK2,
+                               block_option(num, more, self.szx))],
+                             self.block(num))
+            self.repairs += 1
+            logging.info('Repair: block %d to [%s]', num, addr[0])
+        self.sock.sendto(packet.encode(), addr)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Multicast a firmware image to a device group')
+    parser.add_argument('image', help='signed firmware image')
+    parser.add_argument('-g', '--group', default='ff03::fd',
+                        help='group address (CONFIG_FOTA_GROUP_ADDR)')
+    parser.add_argument('-p', '--port', type=int, default=5690,
+                        help='group port (CONFIG_FOTA_GROUP_PORT)')
+    parser.add_argument('-i', '--iface',
+                        help='interface to multicast on')
+    parser.add_argument('-b', '--block-size', type=int, default=256,
+                        choices=[16, 32, 64, 128, 256, 512, 1024],
+                        help='block size (CONFIG_LWM2M_COAP_BLOCK_SIZE)')
+    parser.add_argument('--interval', type=float, default=0.02,
+                        help='seconds between multicast blocks')
+    parser.add_argument('--linger', type=float, default=30,
+                        help='seconds to keep serving repairs once idle')
+    parser.add_argument('--drop', type=float, default=0,
+                        help='share of blocks left out of the multicast')
+    args = parser.parse_args()
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+
+    sender = GroupSender(image, args.group, args.port, args.iface,
+                         args.block_size, args.interval, args.drop)
+    sender.multicast()
+    logging.info('Serving repairs until idle for %d s', args.linger)
+    sender.serve(args.linger)
+    logging.info('Done, %d block(s) repaired', sender.repairs)
+
+
+if __name__ == '__main__':
+    main()
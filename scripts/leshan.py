@@ -15,6 +15,9 @@ import sys
 # Script Version 1.1
 
 headers = { 'Content-Type': 'application/json'}
+# LwM2M content format Leshan asks devices for: TLV carries a whole
+# object instance in one response
+content_format = 'TLV'
 loop_thread_wait     = 1
 download_thread_wait = 5
 update_thread_wait   = 10
@@ -75,7 +78,8 @@ def post(url):
         return False
 
 def get(url, raw=False):
-    response = requests.get(url, headers=headers)
+    response = requests.get(url, headers=headers,
+                            params={'format': content_format})
     if response.status_code in (200, 201):
         try:
             payload = response.json()
@@ -91,6 +95,54 @@ def get(url, raw=False):
         logging.error(response)
         return -1
 
+# Read a whole object instance, returns {resource id: value}
+def get_instance(url):
+    payload = get(url, raw=True)
+    if payload == -1 or 'content' not in payload:
+        return {}
+    resources = {}
+    for resource in payload['content'].get('resources', []):
+        if 'value' in resource:
+            resources[resource['id']] = resource['value']
+        else:
+            resources[resource['id']] = resource.get('values')
+    return resources
+
+# Resources which make up a device health snapshot
+health_paths = ['/3/0/1', '/3/0/3', '/5/0/3', '/5/0/5', '/3303/0/5700']
+
+# Read several resources at once, returns {path: value}. Uses a
+# LwM2M 1.1 Read-Composite when the server and device support it,
+# otherwise one read per object instance.
+def get_composite(hostname, client, paths):
+    url = '%s/api/clients/%s/composite' % (hostname, client)
+    response = requests.get(url, headers=headers,
+                            params={'paths': ','.join(paths)})
+    if response.status_code in (200, 201):
+        try:
+            payload = response.json()
+        except ValueError:
+            payload = {}
+        # Leshan reports device side failures in the payload
+        if payload.get('success') and payload.get('content'):
+            content = payload['content']
+            return dict((path, content[path].get('value'))
+                        for path in paths if path in content)
+
+    values = {}
+    instances = {}
+    for path in paths:
+        instance, resource = path.rsplit('/', 1)
+        instances.setdefault(instance, []).append(path)
+    for instance, instance_paths in instances.items():
+        resources = get_instance('%s/api/clients/%s%s' %
+                                 (hostname, client, instance))
+        for path in instance_paths:
+            resource = int(path.rsplit('/', 1)[1])
+            if resource in resources:
+                values[path] = resources[resource]
+    return values
+
 def put(url, data):
     response = requests.put(url, json=data, headers=headers)
     if response.status_code in (200, 201):
@@ -101,10 +153,11 @@ def put(url, data):
 
 def download(ua, thread_count):
     ua.download_time_start = datetime.datetime.now()
-    download_status_url = '%s/api/clients/%s/5/0/3' % (ua.hostname, ua.client)
-    update_result_url = '%s/api/clients/%s/5/0/5' % (ua.hostname, ua.client)
+    firmware_obj_url = '%s/api/clients/%s/5/0' % (ua.hostname, ua.client)
     while not ua.abort_thread:
-        ua.download_status = get(download_status_url)
+        # state (5/0/3) and update result (5/0/5) in one request
+        firmware_obj = get_instance(firmware_obj_url)
+        ua.download_status = firmware_obj.get(3, -1)
         if ua.download_status == 0:
             if not ua.requested:
                 logging.info('ready for firmware update')
@@ -118,7 +171,7 @@ def download(ua, thread_count):
                     break
                 ua.requested = True
             else:
-                ua.update_result = get(update_result_url)
+                ua.update_result = firmware_obj.get(5, -1)
                 logging.error('failed to start firmware download (%d)', ua.update_result)
                 ua.result = False
                 break
@@ -166,7 +219,79 @@ def update(ua, thread_count):
     ua.update_time_end = datetime.datetime.now()
     thread_count.dec()
 
-def run(client, url, hostname, device, max_threads):
+def peer_url(hostname, peer, port):
+    # Package URI served by a device running CONFIG_FOTA_PEER_SERVER
+    registration = get('%s/api/clients/%s' % (hostname, peer), raw=True)
+    if registration == -1 or 'address' not in registration:
+        logging.error('peer %s is not registered', peer)
+        sys.exit(1)
+    address = registration['address'].lstrip('/').rsplit(':', 1)[0]
+    address = address.strip('[]')
+    if ':' in address:
+        address = '[%s]' % address
+    return 'coap://%s:%d/fw' % (address, port)
+
+def health(client, hostname):
+    response = get('%s/api/clients' % (hostname), raw=True)
+    if response == -1:
+        sys.exit(1)
+    for target in response:
+        if 'endpoint' not in target:
+            continue
+        if client and not client in target['endpoint']:
+            continue
+        snapshot = get_composite(hostname, target['endpoint'], health_paths)
+        logging.info('[%s] %s', target['endpoint'],
+                     ' '.join('%s=%s' % (path, snapshot.get(path))
+                              for path in health_paths))
+
+# Network pool statistics, vendor object 26241 (see src/net_stats.h):
+# one instance per pool, in the order of these options
+pool_object = 26241
+pool_options = ['CONFIG_NET_PKT_RX_COUNT', 'CONFIG_NET_PKT_TX_COUNT',
+                'CONFIG_NET_BUF_RX_COUNT', 'CONFIG_NET_BUF_TX_COUNT']
+
+def targets(client, hostname):
+    response = get('%s/api/clients' % (hostname), raw=True)
+    if response == -1:
+        sys.exit(1)
+    return [t['endpoint'] for t in response if 'endpoint' in t and
+            (not client or client in t['endpoint'])]
+
+def pools_sampling(client, hostname, on):
+    for endpoint in targets(client, hostname):
+        url = '%s/api/clients/%s/%d/0/5' % (hostname, endpoint, pool_object)
+        if put(url, {'id': 5, 'value': on}):
+            logging.info('[%s] pool sampling %s', endpoint,
+                         'on' if on else 'off')
+
+# Print the pool statistics of the targets, then pool sizes for a
+# network_defaults/ profile: the largest high-water mark seen plus
+# headroom, or more than the current size for a pool which ran dry.
+def pools(client, hostname, headroom):
+    worst = [None] * len(pool_options)
+    for endpoint in targets(client, hostname):
+        for pool, option in enumerate(pool_options):
+            stats = get_instance('%s/api/clients/%s/%d/%d' %
+                                 (hostname, endpoint, pool_object, pool))
+            if not stats:
+                continue
+            size, max_used = stats.get(0, 0), stats.get(2, 0)
+            exhausted, empty_ms = stats.get(3, 0), stats.get(4, 0)
+            logging.info('[%s] %s: size %d, max used %d, ran dry %d '
+                         'time(s) for %d ms', endpoint, option, size,
+                         max_used, exhausted, empty_ms)
+            need = max(max_used + 1, -(-max_used * (100 + headroom) // 100))
+            if exhausted:
+                need = max(need, size + max(1, size * headroom // 100))
+            worst[pool] = max(worst[pool] or 0, need)
+    for option, need in zip(pool_options, worst):
+        if need is None:
+            logging.warning('no statistics for %s', option)
+        else:
+            print('config %s\n\tdefault %d\n' % (option[7:], need))
+
+def run(client, url, hostname, device, max_threads, peer=None):
     global aborted
 
     start_time = datetime.datetime.now()
@@ -181,6 +306,9 @@ def run(client, url, hostname, device, max_threads):
                     # check for a partial match of the endpoint
                     if not client in target['endpoint']:
                         start_download = False
+                if peer and target['endpoint'] == peer:
+                    # don't ask the peer to download from itself
+                    start_download = False
                 if start_download and device:
                     endpoint_url = '%s/api/clients/%s/3/0/1'  % (hostname, target['endpoint'])
                     endpoint_device = get(endpoint_url)
@@ -246,12 +374,36 @@ def main():
     description = 'Simple Leshan API wrapper for firmware updates'
     parser = argparse.ArgumentParser(description=description)
     parser.add_argument('-c', '--client', help='Leshan Client ID, if not specified all targets will be updated', default=None)
-    parser.add_argument('-u', '--url', help='URL for client firmware (http:// or coap://)', required=True)
+    group = parser.add_mutually_exclusive_group(required=True)
+    group.add_argument('-s', '--health', help='Only print a health snapshot of the targets', action='store_true')
+    group.add_argument('-u', '--url', help='URL for client firmware (http:// or coap://)')
+    group.add_argument('-p', '--peer', help='Leshan Client ID of a device already running the new firmware, to download it from')
+    group.add_argument('--pools', help='Print network pool statistics and suggest pool sizes', action='store_true')
+    group.add_argument('--pools-sampling', help='Turn network pool sampling on or off', choices=['on', 'off'])
+    parser.add_argument('--headroom', help='Pool size margin over the high-water mark, in percent', type=int, default=25)
+    parser.add_argument('--peer-port', help='Firmware server port of the peer', type=int, default=5685)
     parser.add_argument('-host', '--hostname', help='Leshan server URL', default='https://mgmt.foundries.io/leshan')
     parser.add_argument('-d', '--device', help='Device type filter', default=None)
     parser.add_argument('-t', '--threads', help='Maximum download threads', default=1)
+    parser.add_argument('-f', '--format', help='Content format for reads', default='TLV')
     args = parser.parse_args()
-    run(args.client, args.url, args.hostname, args.device, int(args.threads))
+    global content_format
+    content_format = args.format
+    if args.health:
+        health(args.client, args.hostname)
+        sys.exit(0)
+    if args.pools:
+        pools(args.client, args.hostname, args.headroom)
+        sys.exit(0)
+    if args.pools_sampling:
+        pools_sampling(args.client, args.hostname,
+                       args.pools_sampling == 'on')
+        sys.exit(0)
+    if args.peer:
+        args.url = peer_url(args.hostname, args.peer, args.peer_port)
+        logging.info('downloading from peer %s: %s', args.peer, args.url)
+    run(args.client, args.url, args.hostname, args.device, int(args.threads),
+        args.peer)
 
 if __name__ == '__main__':
     main()
@@ -0,0 +1,261 @@
+# Copyright (c) 2019 Foundries.io
+#
+# SPDX-License-Identifier: Apache-2.0
+
+# Decode the frames of the binary log backend (CONFIG_FOTA_LOG_BACKEND_BINARY,
+# see src/log_backend_bin.c) into log lines, using the zephyr.elf of
+# the build for the format strings and module names:
+#
+#   stty -F /dev/ttyACM0 115200 raw
+#   python3 scripts/log_decode.py build/zephyr/zephyr.elf /dev/ttyACM0
+#
+# Console text between frames is printed as is.
+
+import argparse
+import re
+import struct
+import sys
+
+SYNC = b'\xff\xa5'
+FRAME_STD, FRAME_HEXDUMP, FRAME_CLOCK, FRAME_DROPPED = range(4)
+LEVELS = {1: 'err', 2: 'wrn', 3: 'inf', 4: 'dbg'}
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+CONVERSION = re.compile(r'%([-+ #0]*)(\d+|\*)?(\.\d+)?(hh|h|ll|l|z|j|t)?'
+                        r'([diouxXcsp%])')
+
+
+class Elf:
+    """Memory image of the allocated sections of an ELF file."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            data = f.read()
+        if data[:4] != b'\x7fELF':
+            raise ValueError('%s: not an ELF file' % path)
+        self.wide = data[4] == 2
+        self.endian = '<' if data[5] == 1 else '>'
+        if self.wide:
+            shoff, = struct.unpack_from(self.endian + 'Q', data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from(
+                self.endian + 'HHH', data, 0x3a)
+            layout = 'IIQQQQIIQQ'
+        else:
+            shoff, = struct.unpack_from(self.endian + 'I', data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from(
+                self.endian + 'HHH', data, 0x2e)
+            layout = 'IIIIIIIIII'
+
+        headers = [struct.unpack_from(self.endian + layout, data,
+                                      shoff + i * shentsize)
+                   for i in range(shnum)]
+        names = headers[shstrndx]
+        self.sections = {}
+        self.regions = []
+        for header in headers:
+            name, kind, flags, addr, offset, size = header[:6]
+            name = self.cstring_at(data, names[4] + name)
+            if not flags & SHF_ALLOC or kind == SHT_NOBITS or not size:
+                continue
+            content = data[offset:offset + size]
+            self.sections[name] = (addr, content)
+            self.regions.append((addr, content))
+
+    @staticmethod
+    def cstring_at(data, offset):
+        end = data.index(b'\0', offset)
+        return data[offset:end].decode('utf-8', 'replace')
+
+    def string(self, addr):
+        for start, content in self.regions:
+            if start <= addr < start + len(content):
+                return self.cstring_at(content, addr - start)
+        return '<unknown string 0x%x>' % addr
+
+    def sources(self):
+        """Log module names, indexed by source ID."""
+        if 'log_const_sections' not in self.sections:
+            return []
+        _, content = self.sections['log_const_sections']
+        # struct log_source_const_data: name pointer, then the level
+        size = 16 if self.wide else 8
+        pointer = self.endian + ('Q' if self.wide else 'I')
+        return [self.string(struct.unpack_from(pointer, content, i)[0])
+                for i in range(0, len(content), size)]
+
+
+def format_message(fmt, args):
+    """printf() the way the target would have."""
+    args = list(args)
+
+    def convert(match):
+        flags, width, precision, _, conversion = match.groups()
+        if conversion == '%':
+            return '%'
+        if width == '*':
+            width = str(args.pop(0) if args else 0)
+        if not args:
+            return match.group(0)
+        value = args.pop(0)
+        spec = '%' + flags + (width or '') + (precision or '')
+        if conversion == 's':
+            return (spec + 's') % value
+        if conversion in 'di' and value & 0x80000000:
+            value -= 1 << 32
+        if conversion in 'di':
+            return (spec + 'd') % value
+        if conversion == 'u':
+            return (spec + 'd') % value
+        if conversion == 'c':
+            return chr(value & 0xff)
+        if conversion == 'p':
+            return '0x%08x' % value
+        return (spec + conversion) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def arg_conversions(fmt):
+    """Conversion of each argument of a format, as the target sees them."""
+    conversions = []
+    for match in CONVERSION.finditer(fmt):
+        if match.group(5) == '%':
+            continue
+        if match.group(2) == '*':
+            conversions.append('d')
+        conversions.append(match.group(5))
+    return conversions
+
+
+class Decoder:
+    def __init__(self, elf, freq, out):
+        self.elf = elf
+        self.names = elf.sources()
+        self.freq = freq
+        self.out = out
+        self.buf = b''
+        self.text = b''
+
+    def timestamp(self, ticks):
+        if not self.freq:
+            return '[%010u]' % ticks
+        seconds = ticks / self.freq
+        return '[%02d:%02d:%02d.%06d]' % (
+            seconds // 3600, seconds // 60 % 60, seconds % 60,
+            seconds % 1 * 1000000)
+
+    def source(self, source_id):
+        if source_id < len(self.names):
+            return self.names[source_id]
+        return 'source%d' % source_id
+
+    def header(self, payload):
+        ticks, source_id, level, fmt = struct.unpack_from('<IHBI', payload, 1)
+        return ('%s <%s> %s: ' % (self.timestamp(ticks),
+                                  LEVELS.get(level & 7, '???'),
+                                  self.source(source_id)),
+                self.elf.string(fmt), 12)
+
+    def frame(self, payload):
+        kind = payload[0]
+        if kind == FRAME_STD:
+            prefix, fmt, pos = self.header(payload)
+            args = []
+            strings = arg_conversions(fmt)
+            nargs = payload[pos]
+            pos += 1
+            for i in range(nargs):
+                if i < len(strings) and strings[i] == 's':
+                    length = payload[pos]
+                    args.append(payload[pos + 1:pos + 1 + length].decode(
+                        'utf-8', 'replace'))
+                    pos += 1 + length
+                else:
+                    args.append(struct.unpack_from('<I', payload, pos)[0])
+                    pos += 4
+            self.line(prefix + format_message(fmt, args))
+        elif kind == FRAME_HEXDUMP:
+            prefix, fmt, pos = self.header(payload)
+            data = payload[pos + 1:pos + 1 + payload[pos]]
+            self.line(prefix + fmt)
+            for i in range(0, len(data), 16):
+                self.line('%*s%s' % (len(prefix), '', ' '.join(
+                    '%02x' % b for b in data[i:i + 16])))
+        elif kind == FRAME_CLOCK:
+            self.freq, = struct.unpack_from('<I', payload, 1)
+        elif kind == FRAME_DROPPED:
+            count, = struct.unpack_from('<I', payload, 1)
+            self.line('--- %d messages dropped ---' % count)
+
+    def line(self, text):
+        self.out.write(text + '\n')
+        self.out.flush()
+
+    def feed(self, data):
+        self.buf += data
+        while self.buf:
+            start = self.buf.find(SYNC)
+            if start < 0:
+                # keep a trailing 0xff, it may be the start of a frame
+                keep = 1 if self.buf.endswith(SYNC[:1]) else 0
+                self.console(self.buf[:len(self.buf) - keep])
+                self.buf = self.buf[len(self.buf) - keep:]
+                return
+            self.console(self.buf[:start])
+            self.buf = self.buf[start:]
+            if len(self.buf) < 3:
+                return
+            length = self.buf[2]
+            if len(self.buf) < 4 + length:
+                return
+            payload = self.buf[3:3 + length]
+            if sum(payload) & 0xff != self.buf[3 + length] or \
+                    not payload or payload[0] > FRAME_DROPPED:
+                # not a frame after all, or one which other console
+                # output landed in: resync past this sync byte
+                self.console(self.buf[:1])
+                self.buf = self.buf[1:]
+                continue
+            self.buf = self.buf[4 + length:]
+            try:
+                self.frame(payload)
+            except (struct.error, IndexError):
+                self.line('--- truncated frame ---')
+
+    def console(self, data):
+        self.text += data
+        while b'\n' in self.text:
+            line, self.text = self.text.split(b'\n', 1)
+            self.line(line.rstrip(b'\r').decode('utf-8', 'replace'))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Decode binary log frames into text')
+    parser.add_argument('elf', help='zephyr.elf of the running build')
+    parser.add_argument('input', nargs='?', default='-',
+                        help='serial port or capture file, - for stdin')
+    parser.add_argument('--freq', type=int, default=0,
+                        help='timestamp frequency, if the boot was missed')
+    args = parser.parse_args()
+
+    decoder = Decoder(Elf(args.elf), args.freq, sys.stdout)
+    source = sys.stdin.buffer if args.input == '-' else \
+        open(args.input, 'rb', buffering=0)
+    try:
+        while True:
+            data = source.read1(4096) if hasattr(source, 'read1') else \
+                source.read(4096)
+            if not data:
+                break
+            decoder.feed(data)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        source.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,758 @@
+# Copyright (c) 2019 Foundries.io
+#
+# SPDX-License-Identifier: Apache-2.0
+
+# Local stand-in for the Leshan server, for offline tests and
+# benchmarks. Python standard library only.
+#
+# LwM2M side (CoAP over UDP, no DTLS): registration, update and
+# deregistration; read, write, execute and observe towards the
+# devices; and block-wise downloads of the files in --firmware-dir,
+# as coap://<server>:<port>/fw/<file>.
+#
+# REST side: the subset of Leshan's API the scripts in this directory
+# use, at http://<host>:<http port>/api/...:
+#
+#   GET    /api/clients                       registered clients
+#   GET    /api/clients/<ep>                  one client
+#   GET    /api/clients/<ep>/<path>           read (?format=TLV|TEXT)
+#   PUT    /api/clients/<ep>/<path>           write {"id": .., "value": ..}
+#   POST   /api/clients/<ep>/<path>           execute
+#   POST   /api/clients/<ep>/<path>/observe   observe
+#   DELETE /api/clients/<ep>/<path>/observe   cancel an observation
+#   GET    /event                             server-sent events
+#   GET    /api/timings                       recorded timings (?clear=1)
+#
+# Events are REGISTRATION, UPDATED, DEREGISTRATION (data: the client)
+# and NOTIFICATION (data: {"ep": .., "res": .., "val": ..}).
+#
+# Every operation is timed. Timings are logged, and kept for
+# /api/timings: registrations (time since the server started),
+# requests to devices (round trip) and firmware transfers.
+
+import argparse
+import collections
+import json
+import logging
+import os
+import queue
+import random
+import select
+import socket
+import struct
+import threading
+import time
+import urllib.parse
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+from coap import (ACK, BAD_REQUEST, CHANGED, CON, CONTENT, CREATED, DELETE,
+                  DELETED, GET, NON, NOT_FOUND, OPT_ACCEPT, OPT_BLOCK2,
+                  OPT_CONTENT_FORMAT, OPT_LOCATION_PATH, OPT_OBSERVE,
+                  OPT_SIZE2, OPT_URI_PATH, POST, PUT, RST, STATUS, Message,
+                  block_fields, block_option, block_size, block_szx,
+                  encode_uint)
+
+FORMAT_TEXT = 0
+FORMAT_LINK = 40
+FORMAT_OPAQUE = 42
+FORMAT_TLV = 11542
+FORMAT_JSON = 11543
+
+FORMATS = {'TEXT': FORMAT_TEXT, 'TLV': FORMAT_TLV, 'JSON': FORMAT_JSON,
+           'OPAQUE': FORMAT_OPAQUE}
+
+ACK_TIMEOUT = 2.0
+MAX_RETRANSMIT = 4
+BLOCK_SIZE = 256
+
+# Resource types of the objects this application implements, to
+# decode values. Anything else is guessed from its length.
+MODEL = {
+    (3, 0): 'string', (3, 1): 'string', (3, 2): 'string', (3, 3): 'string',
+    (3, 9): 'int', (3, 10): 'int', (3, 13): 'int', (3, 17): 'string',
+    (3, 18): 'string', (3, 19): 'string', (3, 21): 'int',
+    (5, 1): 'string', (5, 3): 'int', (5, 5): 'int', (5, 6): 'string',
+    (5, 7): 'string', (5, 9): 'int',
+    (3303, 5601): 'float', (3303, 5602): 'float', (3303, 5700): 'float',
+    (3303, 5701): 'string',
+    (3311, 5850): 'bool', (3311, 5851): 'int', (3311, 5852): 'int',
+}
+
+logging.basicConfig(level=logging.INFO,
+                    format='%(asctime)s [%(levelname)s] %(message)s')
+
+
+def decode_value(obj, res, data, fmt):
+    kind = MODEL.get((obj, res))
+    if fmt == FORMAT_TEXT:
+        text = data.decode(errors='replace')
+        try:
+            if kind == 'int':
+                return int(text)
+            if kind == 'float':
+                return float(text)
+            if kind == 'bool':
+                return text == '1'
+        except ValueError:
+            pass
+        return text
+    if kind == 'string':
+        return data.decode(errors='replace')
+    if kind == 'float' and len(data) in (4, 8):
+        return struct.unpack('>f' if len(data) == 4 else '>d', data)[0]
+    if kind == 'bool' and len(data) == 1:
+        return data[0] != 0
+    if kind in ('int', None) and len(data) in (1, 2, 4, 8):
+        return int.from_bytes(data, 'big', signed=True)
+    try:
+        return data.decode()
+    except UnicodeDecodeError:
+        return data.hex()
+
+
+def decode_tlv(data):
+    entries = []
+    pos = 0
+    while pos < len(data):
+        kind = data[pos]
+        pos += 1
+        id_len = 2 if kind & 0x20 else 1
+        ident = int.from_bytes(data[pos:pos + id_len], 'big')
+        pos += id_len
+        len_type = (kind >> 3) & 0x3
+        if len_type:
+            length = int.from_bytes(data[pos:pos + len_type], 'big')
+            pos += len_type
+        else:
+            length = kind & 0x7
+        entries.append((kind >> 6, ident, data[pos:pos + length]))
+        pos += length
+    return entries
+
+
+def tlv_resources(obj, entries):
+    resources = []
+    for kind, ident, value in entries:
+        if kind == 3:
+            resources.append({'id': ident,
+                              'value': decode_value(obj, ident, value,
+                                                    FORMAT_TLV)})
+        elif kind == 2:
+            values = dict((str(i), decode_value(obj, ident, v, FORMAT_TLV))
+                          for _, i, v in decode_tlv(value))
+            resources.append({'id': ident, 'values': values})
+    return resources
+
+
+def decode_content(path, data, fmt):
+    obj = path[0]
+    if fmt == FORMAT_TLV:
+        entries = decode_tlv(data)
+        if len(path) == 3:
+            resources = tlv_resources(obj, entries)
+            return resources[0] if resources else {'id': path[2]}
+        if len(path) == 2:
+            if entries and entries[0][0] == 0:
+                entries = decode_tlv(entries[0][2])
+            return {'id': path[1], 'resources': tlv_resources(obj, entries)}
+        return {'id': obj, 'instances': [
+            {'id': ident, 'resources': tlv_resources(obj, decode_tlv(value))}
+            for _, ident, value in entries]}
+    if fmt == FORMAT_JSON:
+        return {'id': path[-1], 'value': json.loads(data.decode())}
+    res = path[2] if len(path) == 3 else 0
+    return {'id': path[-1], 'value': decode_value(obj, res, data, fmt)}
+
+
+def encode_text(value):
+    if isinstance(value, bool):
+        return b'1' if value else b'0'
+    return str(value).encode()
+
+
+class Timings:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.entries = collections.deque(maxlen=100000)
+
+    def add(self, **entry):
+        entry['time'] = time.time()
+        with self.lock:
+            self.entries.append(entry)
+        logging.info('timing %s', ' '.join('%s=%s' % (k, v) for k, v in
+                                           sorted(entry.items())
+                                           if k != 'time'))
+
+    def dump(self, clear=False):
+        with self.lock:
+            entries = list(self.entries)
+            if clear:
+                self.entries.clear()
+        return entries
+
+
+class Client:
+    def __init__(self, endpoint, reg_id, addr, query, links):
+        self.endpoint = endpoint
+        self.reg_id = reg_id
+        self.addr = addr
+        self.lifetime = int(query.get('lt', 86400))
+        self.version = query.get('lwm2m', '1.0')
+        self.binding = query.get('b', 'U')
+        self.links = links
+        self.registered = time.time()
+        self.updated = self.registered
+
+    def json(self):
+        return {
+            'endpoint': self.endpoint,
+            'registrationId': self.reg_id,
+            'address': '%s:%d' % (self.addr[0], self.addr[1]),
+            'lifetime': self.lifetime,
+            'lwM2mVersion': self.version,
+            'bindingMode': self.binding,
+            'objectLinks': [{'url': link} for link in self.links],
+            'registrationDate': time.strftime(
+                '%Y-%m-%dT%H:%M:%SZ', time.gmtime(self.registered)),
+            'lastUpdate': time.strftime(
+                '%Y-%m-%dT%H:%M:%SZ', time.gmtime(self.updated)),
+            'secure': False,
+        }
+
+
+class Transfer:
+    def __init__(self):
+        self.start = time.time()
+        self.blocks = 0
+        self.bytes = 0
+
+
+class CoapServer:
+    def __init__(self, port, firmware_dir, events, timings):
+        self.sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.IPPROTO_IPV6, socket.IPV6_V6ONLY, 0)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.bind(('::', port))
+        self.firmware_dir = firmware_dir
+        self.events = events
+        self.timings = timings
+        self.started = time.time()
+        self.lock = threading.Lock()
+        self.clients = {}
+        self.mid = random.randint(0, 0xffff)
+        # token -> pending request state
+        self.pending = {}
+        # token -> (endpoint, path, format) of observations
+        self.observations = {}
+        # (addr, mid) -> response, for duplicate CON messages
+        self.recent = collections.OrderedDict()
+        self.transfers = {}
+
+    def next_mid(self):
+        with self.lock:
+            self.mid = (self.mid + 1) & 0xffff
+            return self.mid
+
+    def send(self, msg, addr):
+        self.sock.sendto(msg.encode(), addr)
+
+    def reply(self, req, addr, code, options=None, payload=b''):
+        if req.mtype == CON:
+            msg = Message(ACK, code, req.mid, req.token, options, payload)
+        else:
+            msg = Message(NON, code, self.next_mid(), req.token, options,
+                          payload)
+        self.recent[(addr, req.mid)] = msg
+        while len(self.recent) > 1000:
+            self.recent.popitem(last=False)
+        self.send(msg, addr)
+
+    def client(self, endpoint):
+        with self.lock:
+            return self.clients.get(endpoint)
+
+    def client_list(self):
+        with self.lock:
+            return list(self.clients.values())
+
+    def run(self):
+        while True:
+            readable, _, _ = select.select([self.sock], [], [], 1.0)
+            if readable:
+                data, addr = self.sock.recvfrom(4096)
+                msg = Message.decode(data)
+                if msg:
+                    try:
+                        self.handle(msg, addr)
+                    except Exception:
+                        logging.exception('Error handling message')
+            self.expire()
+
+    def expire(self):
+        now = time.time()
+        for client in self.client_list():
+            if now > client.updated + client.lifetime + 30:
+                logging.info('%s expired', client.endpoint)
+                self.deregister(client)
+
+    def handle(self, msg, addr):
+        if msg.code == 0:
+            # empty ACK or RST
+            if msg.mtype == RST:
+                self.cancel_token(msg.token)
+            return
+        if msg.code < 0x20:
+            if msg.mtype == CON and (addr, msg.mid) in self.recent:
+                self.send(self.recent[(addr, msg.mid)], addr)
+                return
+            self.handle_request(msg, addr)
+        else:
+            self.handle_response(msg, addr)
+
+    def handle_request(self, msg, addr):
+        path = msg.path()
+        if path[:1] == ['rd']:
+            if msg.code == POST and len(path) == 1:
+                self.register(msg, addr)
+            elif msg.code == POST and len(path) == 2:
+                self.update(msg, addr, path[1])
+            elif msg.code == DELETE and len(path) == 2:
+                self.unregister(msg, addr, path[1])
+            else:
+                self.reply(msg, addr, BAD_REQUEST)
+        elif path[:1] == ['fw'] and msg.code == GET:
+            self.serve_firmware(msg, addr, path[1:])
+        else:
+            self.reply(msg, addr, NOT_FOUND)
+
+    def register(self, msg, addr):
+        query = msg.query()
+        endpoint = query.get('ep')
+        if not endpoint:
+            self.reply(msg, addr, BAD_REQUEST)
+            return
+        links = [link.strip().strip('<>').split('>')[0]
+                 for link in msg.payload.decode().split(',') if link]
+        reg_id = '%08x' % random.getrandbits(32)
+        client = Client(endpoint, reg_id, addr, query, links)
+        with self.lock:
+            old = self.clients.get(endpoint)
+            self.clients[endpoint] = client
+        if old:
+            self.drop_observations(endpoint)
+        self.reply(msg, addr, CREATED,
+                   [(OPT_LOCATION_PATH, b'rd'),
+                    (OPT_LOCATION_PATH, reg_id.encode())])
+        self.timings.add(op='register', ep=endpoint,
+                         since_start_ms=int((time.time() - self.started) *
+                                            1000))
+        self.events.publish('REGISTRATION', client.json())
+
+    def find(self, reg_id):
+        for client in self.client_list():
+            if client.reg_id == reg_id:
+                return client
+        return None
+
+    def update(self, msg, addr, reg_id):
+        client = self.find(reg_id)
+        if not client:
+            self.reply(msg, addr, NOT_FOUND)
+            return
+        query = msg.query()
+        if 'lt' in query:
+            client.lifetime = int(query['lt'])
+        if 'b' in query:
+            client.binding = query['b']
+        if msg.payload:
+            client.links = [link.strip().strip('<>').split('>')[0]
+                            for link in msg.payload.decode().split(',')
+                            if link]
+        client.addr = addr
+        client.updated = time.time()
+        self.reply(msg, addr, CHANGED)
+        self.timings.add(op='update', ep=client.endpoint)
+        self.events.publish('UPDATED', client.json())
+
+    def unregister(self, msg, addr, reg_id):
+        client = self.find(reg_id)
+        if not client:
+            self.reply(msg, addr, NOT_FOUND)
+            return
+        self.reply(msg, addr, DELETED)
+        self.deregister(client)
+
+    def deregister(self, client):
+        with self.lock:
+            if self.clients.get(client.endpoint) is client:
+                del self.clients[client.endpoint]
+        self.drop_observations(client.endpoint)
+        self.events.publish('DEREGISTRATION', client.json())
+
+    def serve_firmware(self, msg, addr, path):
+        name = os.path.basename('/'.join(path))
+        filename = os.path.join(self.firmware_dir or '', name)
+        if not self.firmware_dir or not name or \
+           not os.path.isfile(filename):
+            self.reply(msg, addr, NOT_FOUND)
+            return
+        block = msg.opt_uint(OPT_BLOCK2)
+        if block is None:
+            num, szx = 0, block_szx(BLOCK_SIZE)
+        else:
+            num, _, szx = block_fields(block)
+        # SZX 7 is reserved
+        szx = min(szx, 6)
+        size = block_size(szx)
+        with open(filename, 'rb') as f:
+            f.seek(num * size)
+            data = f.read(size)
+            total = os.fstat(f.fileno()).st_size
+        more = (num + 1) * size < total
+        options = [(OPT_CONTENT_FORMAT, encode_uint(FORMAT_OPAQUE)),
+                   (OPT_BLOCK2, block_option(num, more, szx))]
+        if num == 0:
+            options.append((OPT_SIZE2, encode_uint(total)))
+            self.transfers[addr] = Transfer()
+        self.reply(msg, addr, CONTENT, options, data)
+
+        transfer = self.transfers.get(addr)
+        if transfer:
+            transfer.blocks += 1
+            transfer.bytes += len(data)
+            if not more:
+                del self.transfers[addr]
+                client = [c.endpoint for c in self.client_list()
+                          if c.addr[0] == addr[0]]
+                self.timings.add(op='fw_transfer',
+                                 ep=client[0] if client else addr[0],
+                                 file=name, bytes=transfer.bytes,
+                                 blocks=transfer.blocks,
+                                 ms=int((time.time() - transfer.start) *
+                                        1000))
+
+    def handle_response(self, msg, addr):
+        if msg.mtype == CON:
+            self.send(Message(ACK, 0, msg.mid), addr)
+        with self.lock:
+            pending = self.pending.get(msg.token)
+            observation = self.observations.get(msg.token)
+        if pending and not pending['done'].is_set():
+            pending['response'] = msg
+            pending['done'].set()
+        elif observation and msg.opt(OPT_OBSERVE):
+            endpoint, path, _ = observation
+            fmt = msg.opt_uint(OPT_CONTENT_FORMAT) or 0
+            try:
+                value = decode_content(path, msg.payload, fmt)
+            except Exception:
+                value = {'raw': msg.payload.hex()}
+            self.events.publish('NOTIFICATION', {
+                'ep': endpoint,
+                'res': '/' + '/'.join(str(p) for p in path),
+                'val': value,
+            })
+        elif msg.mtype in (CON, NON):
+            self.send(Message(RST, 0, msg.mid), addr)
+
+    def request(self, client, code, path, options=None, payload=b'',
+                token=None):
+        token = token or os.urandom(4)
+        options = [(OPT_URI_PATH, str(p).encode()) for p in path] + \
+            (options or [])
+        msg = Message(CON, code, self.next_mid(), token, options, payload)
+        pending = {'done': threading.Event(), 'response': None}
+        with self.lock:
+            self.pending[token] = pending
+        try:
+            timeout = ACK_TIMEOUT * random.uniform(1, 1.5)
+            for _ in range(MAX_RETRANSMIT + 1):
+                self.send(msg, client.addr)
+                if pending['done'].wait(timeout):
+                    return pending['response']
+                timeout *= 2
+            return None
+        finally:
+            with self.lock:
+                self.pending.pop(token, None)
+
+    def read(self, client, code, path, accept, options=None, token=None):
+        # follow Block2 until the whole content is in
+        content = b''
+        num = 0
+        while True:
+            opts = list(options or [])
+            if accept is not None:
+                opts.append((OPT_ACCEPT, encode_uint(accept)))
+            if num:
+                opts.append((OPT_BLOCK2, block_option(
+                    num, False, block_fields(block)[2])))
+            response = self.request(client, code, path, opts, token=token)
+            if not response or response.code != CONTENT:
+                return response, content
+            content += response.payload
+            block = response.opt_uint(OPT_BLOCK2)
+            if block is None or not block_fields(block)[1]:
+                return response, content
+            num = block_fields(block)[0] + 1
+            # only the first request carries the observe option
+            options = [o for o in (options or []) if o[0] != OPT_OBSERVE]
+
+    def observe(self, client, path, accept):
+        token = os.urandom(4)
+        with self.lock:
+            self.observations[token] = (client.endpoint, path, accept)
+        response, content = self.read(client, GET, path, accept,
+                                      [(OPT_OBSERVE, b'')], token)
+        if not response or response.code != CONTENT:
+            with self.lock:
+                self.observations.pop(token, None)
+        return response, content
+
+    def cancel(self, client, path):
+        with self.lock:
+            tokens = [t for t, (ep, p, _) in self.observations.items()
+                      if ep == client.endpoint and p == path]
+            for token in tokens:
+                del self.observations[token]
+        for token in tokens:
+            # active cancel: GET with Observe=1
+            self.request(client, GET, path, [(OPT_OBSERVE, b'\x01')],
+                         token=token)
+        return len(tokens)
+
+    def cancel_token(self, token):
+        with self.lock:
+            self.observations.pop(token, None)
+
+    def drop_observations(self, endpoint):
+        with self.lock:
+            for token in [t for t, (ep, _, _) in self.observations.items()
+                          if ep == endpoint]:
+                del self.observations[token]
+
+
+class Events:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.subscribers = []
+
+    def subscribe(self, endpoint=None):
+        q = queue.Queue(maxsize=10000)
+        with self.lock:
+            self.subscribers.append((q, endpoint))
+        return q
+
+    def unsubscribe(self, q):
+        with self.lock:
+            self.subscribers = [s for s in self.subscribers if s[0] is not q]
+
+    def publish(self, name, data):
+        endpoint = data.get('ep', data.get('endpoint'))
+        with self.lock:
+            subscribers = list(self.subscribers)
+        for q, ep in subscribers:
+            if ep and ep != endpoint:
+                continue
+            try:
+                q.put_nowait((name, data))
+            except queue.Full:
+                pass
+
+
+def make_handler(coap, events, timings):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = 'HTTP/1.1'
+
+        def log_message(self, fmt, *args):
+            logging.debug(fmt, *args)
+
+        def send_json(self, status, data):
+            body = json.dumps(data).encode()
+            self.send_response(status)
+            self.send_header('Content-Type', 'application/json')
+            self.send_header('Content-Length', str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def parse(self):
+            url = urllib.parse.urlparse(self.path)
+            query = dict(urllib.parse.parse_qsl(url.query))
+            return [p for p in url.path.split('/') if p], query
+
+        def do_GET(self):
+            parts, query = self.parse()
+            if parts == ['event']:
+                self.stream_events(query.get('ep'))
+            elif parts == ['api', 'timings']:
+                self.send_json(200, timings.dump(query.get('clear') == '1'))
+            elif parts == ['api', 'clients']:
+                self.send_json(200, [c.json() for c in coap.client_list()])
+            elif parts[:2] == ['api', 'clients'] and len(parts) == 3:
+                client = coap.client(parts[2])
+                if client:
+                    self.send_json(200, client.json())
+                else:
+                    self.send_json(404, {'message': 'no such client'})
+            elif parts[:2] == ['api', 'clients'] and len(parts) > 3:
+                self.device_op('read', parts[2], parts[3:], query)
+            else:
+                self.send_json(404, {'message': 'not found'})
+
+        def do_PUT(self):
+            parts, query = self.parse()
+            if parts[:2] == ['api', 'clients'] and len(parts) > 3:
+                self.device_op('write', parts[2], parts[3:], query)
+            else:
+                self.send_json(404, {'message': 'not found'})
+
+        def do_POST(self):
+            parts, query = self.parse()
+            if parts[:2] == ['api', 'clients'] and len(parts) > 3:
+                if parts[-1] == 'observe':
+                    self.device_op('observe', parts[2], parts[3:-1], query)
+                else:
+                    self.device_op('execute', parts[2], parts[3:], query)
+            else:
+                self.send_json(404, {'message': 'not found'})
+
+        def do_DELETE(self):
+            parts, query = self.parse()
+            if parts[:2] == ['api', 'clients'] and len(parts) > 4 and \
+               parts[-1] == 'observe':
+                client = coap.client(parts[2])
+                if not client:
+                    self.send_json(404, {'message': 'no such client'})
+                    return
+                path = [int(p) for p in parts[3:-1]]
+                self.send_json(200, {'cancelled': coap.cancel(client, path)})
+            else:
+                self.send_json(404, {'message': 'not found'})
+
+        def body(self):
+            length = int(self.headers.get('Content-Length', 0))
+            if not length:
+                return None
+            return json.loads(self.rfile.read(length).decode())
+
+        def device_op(self, op, endpoint, parts, query):
+            client = coap.client(endpoint)
+            if not client:
+                self.send_json(404, {'message': 'no such client'})
+                return
+            try:
+                path = [int(p) for p in parts]
+            except ValueError:
+                self.send_json(400, {'message': 'bad path'})
+                return
+            accept = FORMATS.get(query.get('format', 'TLV').upper(),
+                                 FORMAT_TLV)
+            if op == 'read' and len(path) == 3 and accept == FORMAT_JSON:
+                accept = FORMAT_TEXT
+
+            start = time.time()
+            content = b''
+            if op == 'read':
+                response, content = coap.read(client, GET, path, accept)
+            elif op == 'observe':
+                response, content = coap.observe(client, path, accept)
+            elif op == 'write':
+                body = self.body() or {}
+                response = coap.request(
+                    client, PUT, path,
+                    [(OPT_CONTENT_FORMAT, encode_uint(FORMAT_TEXT))],
+                    encode_text(body.get('value', '')))
+            else:
+                response = coap.request(client, POST, path)
+            ms = int((time.time() - start) * 1000)
+
+            if response is None:
+                timings.add(op=op, ep=endpoint, path='/'.join(parts), ms=ms,
+                            status='TIMEOUT')
+                self.send_json(504, {'message': 'request timeout'})
+                return
+
+            status = STATUS.get(response.code, '%d.%02d' %
+                                (response.code >> 5, response.code & 0x1f))
+            timings.add(op=op, ep=endpoint, path='/'.join(parts), ms=ms,
+                        status=status)
+            success = response.code < 0x80
+            result = {'status': status, 'valid': True, 'success': success,
+                      'failure': not success}
+            if response.code == CONTENT:
+                fmt = response.opt_uint(OPT_CONTENT_FORMAT) or 0
+                try:
+                    result['content'] = decode_content(path, content, fmt)
+                except Exception as e:
+                    result['content'] = {'raw': content.hex()}
+                    logging.warning('Cannot decode %s: %s', path, e)
+            self.send_json(200, result)
+
+        def stream_events(self, endpoint):
+            q = events.subscribe(endpoint)
+            self.send_response(200)
+            self.send_header('Content-Type', 'text/event-stream')
+            self.send_header('Cache-Control', 'no-cache')
+            self.send_header('Connection', 'close')
+            self.end_headers()
+            self.close_connection = True
+            try:
+                while True:
+                    try:
+                        name, data = q.get(timeout=15)
+                        chunk = 'event: %s\ndata: %s\n\n' % (
+                            name, json.dumps(data))
+                    except queue.Empty:
+                        chunk = ': keep-alive\n\n'
+                    self.wfile.write(chunk.encode())
+                    self.wfile.flush()
+            except (BrokenPipeError, ConnectionResetError):
+                pass
+            finally:
+                events.unsubscribe(q)
+
+    return Handler
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Local LwM2M server with a Leshan-like REST API')
+    parser.add_argument('-p', '--coap-port', type=int, default=5683,
+                        help='CoAP port')
+    parser.add_argument('-w', '--http-port', type=int, default=8080,
+                        help='REST API port')
+    parser.add_argument('--http-host', default='::',
+                        help='REST API address')
+    parser.add_argument('-f', '--firmware-dir',
+                        help='serve the files in this directory at /fw/')
+    parser.add_argument('-v', '--verbose', action='store_true')
+    args = parser.parse_args()
+
+    if args.verbose:
+        logging.getLogger().setLevel(logging.DEBUG)
+
+    events = Events()
+    timings = Timings()
+    coap = CoapServer(args.coap_port, args.firmware_dir, events, timings)
+    threading.Thread(target=coap.run, name='coap', daemon=True).start()
+
+    class Server(ThreadingHTTPServer):
+        address_family = socket.AF_INET6 if ':' in args.http_host \
+            else socket.AF_INET
+        daemon_threads = True
+
+    httpd = Server((args.http_host, args.http_port),
+                   make_handler(coap, events, timings))
+    logging.info('CoAP on port %d, REST API on http://[%s]:%d/api',
+                 args.coap_port, args.http_host, args.http_port)
+    if args.firmware_dir:
+        logging.info('Firmware from %s at coap://<this host>:%d/fw/<file>',
+                     args.firmware_dir, args.coap_port)
+    try:
+        httpd.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
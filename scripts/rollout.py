@@ -0,0 +1,313 @@
+# Copyright (c) 2019 Foundries.io
+#
+# SPDX-License-Identifier: Apache-2.0
+
+# Staged firmware rollout: update the fleet in waves, a canary first,
+# then growing fractions of it, and only go on while the previous wave
+# went well.
+#
+# Waves are given as device counts or cumulative percentages of the
+# fleet, e.g. the default "1,5%,25%,100%". Before each following wave,
+# the previous one must have reached --min-success, and its slowest
+# updates (90th percentile) must have stayed under --max-duration and
+# under --max-slowdown times the canary's.
+#
+# With --max-bandwidth, new downloads are only admitted while the
+# expected aggregate download rate stays under that ceiling. The rate
+# of a download is learnt from the ones which completed (image size
+# over download time), starting from --initial-rate.
+#
+# Devices and updates are handled as in fota_orchestrator.py.
+
+import argparse
+import asyncio
+import json
+import logging
+import random
+import signal
+import sys
+import time
+import urllib.request
+
+import aiohttp
+
+from fota_orchestrator import Device, Server, select_targets
+
+logging.basicConfig(level=logging.INFO,
+                    format='%(asctime)s [%(levelname)s] %(message)s')
+
+
+def parse_size(text):
+    units = {'k': 1000, 'm': 1000 ** 2, 'g': 1000 ** 3}
+    text = text.strip().lower()
+    if text[-1:] in units:
+        return float(text[:-1]) * units[text[-1]]
+    return float(text)
+
+
+def wave_sizes(spec, total):
+    """Cumulative device counts of each wave."""
+    sizes = []
+    for item in spec.split(','):
+        item = item.strip()
+        if item.endswith('%'):
+            size = -(-total * int(item[:-1]) // 100)
+        else:
+            size = int(item)
+        size = min(total, max(size, sizes[-1] if sizes else 0))
+        # waves without devices are skipped
+        if size > (sizes[-1] if sizes else 0):
+            sizes.append(size)
+    if total and (not sizes or sizes[-1] < total):
+        sizes.append(total)
+    return sizes
+
+
+def p90(values):
+    if not values:
+        return None
+    values = sorted(values)
+    return values[min(len(values) - 1, int(0.9 * len(values)))]
+
+
+class Admission:
+    """Admit downloads while the expected bandwidth allows it."""
+
+    def __init__(self, ceiling, image_size, initial_rate):
+        self.ceiling = ceiling
+        self.image_size = image_size
+        # bytes/s of one download, smoothed
+        self.rate = initial_rate
+        self.active = 0
+        self.condition = asyncio.Condition()
+
+    def expected(self, downloads):
+        return downloads * self.rate
+
+    async def __aenter__(self):
+        async with self.condition:
+            # one download is always allowed, however slow
+            await self.condition.wait_for(
+                lambda: not self.ceiling or self.active == 0 or
+                self.expected(self.active + 1) <= self.ceiling)
+            self.active += 1
+            self.start = time.monotonic()
+
+    async def __aexit__(self, *exc):
+        async with self.condition:
+            self.active -= 1
+            self.condition.notify_all()
+
+    def completed(self, download_s):
+        if not download_s or not self.image_size:
+            return
+        rate = self.image_size / download_s
+        self.rate = 0.8 * self.rate + 0.2 * rate
+        logging.debug('download rate %.0f B/s, %d active, %.0f B/s expected',
+                      self.rate, self.active, self.expected(self.active))
+
+
+class RolloutDevice(Device):
+    async def run(self, slots, admission):
+        async with slots:
+            try:
+                # only the download itself counts against the bandwidth
+                async with admission:
+                    await self.download()
+                admission.completed(self.download_s)
+                await self.update()
+            except asyncio.TimeoutError:
+                self.error = 'timeout'
+            except (aiohttp.ClientError, RuntimeError) as e:
+                self.error = str(e)
+            if self.error:
+                logging.error('[%s] %s', self.endpoint, self.error)
+
+    def duration(self):
+        return (self.download_s or 0) + (self.update_s or 0)
+
+
+async def up_to_date(server, targets, version, parallel):
+    slots = asyncio.Semaphore(parallel)
+
+    async def current(endpoint):
+        async with slots:
+            try:
+                return await server.read(endpoint, '3/0/3') == version
+            except (aiohttp.ClientError, RuntimeError):
+                return False
+
+    done = await asyncio.gather(*(current(t) for t in targets))
+    return [t for t, d in zip(targets, done) if d]
+
+
+def gate(args, wave, canary_p90):
+    """Whether the next wave may go, and why not."""
+    if wave['success_rate'] < args.min_success:
+        return 'success rate %.0f%% under %.0f%%' % (
+            100 * wave['success_rate'], 100 * args.min_success)
+    if wave['p90_s'] is None:
+        return None
+    if args.max_duration and wave['p90_s'] > args.max_duration:
+        return 'updates took %.0f s, over %.0f s' % (wave['p90_s'],
+                                                      args.max_duration)
+    if canary_p90 and args.max_slowdown and \
+       wave['p90_s'] > args.max_slowdown * canary_p90:
+        return 'updates took %.0f s, %.1f times the canary\'s %.0f s' % (
+            wave['p90_s'], wave['p90_s'] / canary_p90, canary_p90)
+    return None
+
+
+async def rollout(args):
+    server = Server(args.hostname, args.format, args.connections)
+    events = asyncio.ensure_future(server.events())
+    report = {'waves': []}
+    try:
+        targets = await select_targets(server, args)
+        if args.version:
+            skip = set(await up_to_date(server, targets, args.version,
+                                        args.parallel))
+            logging.info('%d device(s) already run %s', len(skip),
+                         args.version)
+            targets = [t for t in targets if t not in skip]
+        if not targets:
+            logging.info('no device to update')
+            return 0
+        random.Random(args.seed).shuffle(targets)
+        sizes = wave_sizes(args.waves, len(targets))
+        logging.info('rolling out to %d device(s) in waves of %s',
+                     len(targets), sizes)
+
+        admission = Admission(args.max_bandwidth, args.image_size,
+                              args.initial_rate)
+        slots = asyncio.Semaphore(args.parallel)
+        canary_p90 = None
+        done = 0
+        for number, size in enumerate(sizes):
+            devices = [RolloutDevice(server, endpoint, args)
+                       for endpoint in targets[done:size]]
+            server.devices = dict((d.endpoint, d) for d in devices)
+            await asyncio.sleep(1)
+
+            start = time.monotonic()
+            await asyncio.gather(*(d.run(slots, admission) for d in devices))
+            ok = [d for d in devices if not d.error]
+            wave = {
+                'wave': number,
+                'devices': len(devices),
+                'succeeded': len(ok),
+                'success_rate': len(ok) / len(devices),
+                'p90_s': p90([d.duration() for d in ok]),
+                'elapsed_s': time.monotonic() - start,
+                'download_rate': admission.rate,
+                'results': [d.report() for d in devices],
+            }
+            report['waves'].append(wave)
+            done = size
+            logging.info('wave %d: %d/%d updated, 90%% within %s s, in %.0f s',
+                         number, len(ok), len(devices),
+                         '%.0f' % wave['p90_s'] if ok else '-',
+                         wave['elapsed_s'])
+
+            if number == 0:
+                canary_p90 = wave['p90_s']
+            if done == len(targets):
+                break
+            reason = gate(args, wave, canary_p90)
+            if reason:
+                logging.error('stopping the rollout after wave %d: %s',
+                              number, reason)
+                report['stopped'] = reason
+                break
+            if args.pause:
+                logging.info('waiting %d s before the next wave', args.pause)
+                await asyncio.sleep(args.pause)
+    finally:
+        events.cancel()
+        await server.close()
+        if args.output:
+            with open(args.output, 'w') as f:
+                json.dump(report, f, indent=2)
+                f.write('\n')
+
+    return 1 if report.get('stopped') or \
+        any(w['succeeded'] < w['devices'] for w in report['waves']) else 0
+
+
+def image_size(url):
+    # Package URI's size, when it can be asked for over HTTP
+    if not url.startswith('http'):
+        return None
+    request = urllib.request.Request(url, method='HEAD')
+    with urllib.request.urlopen(request, timeout=30) as response:
+        length = response.headers.get('Content-Length')
+    return int(length) if length else None
+
+
+def main():
+    description = 'Staged Leshan firmware rollout with admission control'
+    parser = argparse.ArgumentParser(description=description)
+    parser.add_argument('-u', '--url', required=True,
+                        help='URL for client firmware (http:// or coap://)')
+    parser.add_argument('-c', '--client', default=None,
+                        help='Leshan Client ID filter, all targets if unset')
+    parser.add_argument('-host', '--hostname',
+                        default='https://mgmt.foundries.io/leshan',
+                        help='Leshan server URL')
+    parser.add_argument('-d', '--device', default=None,
+                        help='Device type filter')
+    parser.add_argument('-V', '--version',
+                        help='skip devices which already run this version')
+    parser.add_argument('-w', '--waves', default='1,5%,25%,100%',
+                        help='cumulative wave sizes, counts or percentages')
+    parser.add_argument('--seed', type=int, default=0,
+                        help='seed of the random device order')
+    parser.add_argument('--min-success', type=float, default=0.95,
+                        help='success rate a wave needs for the next to go')
+    parser.add_argument('--max-duration', type=float, default=0,
+                        help='longest 90th percentile update time, seconds')
+    parser.add_argument('--max-slowdown', type=float, default=2,
+                        help='longest 90th percentile update time, relative '
+                             'to the canary\'s')
+    parser.add_argument('--pause', type=int, default=0,
+                        help='seconds to wait between waves')
+    parser.add_argument('-b', '--max-bandwidth', type=parse_size, default=0,
+                        help='aggregate download ceiling in bytes/s '
+                             '(k, M, G suffixes), unlimited if 0')
+    parser.add_argument('--image-size', type=parse_size,
+                        help='image size in bytes, if not found from the URL')
+    parser.add_argument('--initial-rate', type=parse_size, default=2000,
+                        help='assumed bytes/s of one download until measured')
+    parser.add_argument('-p', '--parallel', type=int, default=100,
+                        help='devices updated at the same time')
+    parser.add_argument('--connections', type=int, default=20,
+                        help='HTTP connections to the server')
+    parser.add_argument('-f', '--format', default='TLV',
+                        help='Content format for reads')
+    parser.add_argument('--fallback', type=float, default=60,
+                        help='read the state after this many seconds '
+                             'without a notification')
+    parser.add_argument('--download-timeout', type=float, default=3600)
+    parser.add_argument('--update-timeout', type=float, default=600)
+    parser.add_argument('-o', '--output',
+                        help='write the per-wave report here, as JSON')
+    args = parser.parse_args()
+
+    if args.max_bandwidth and not args.image_size:
+        args.image_size = image_size(args.url)
+        if not args.image_size:
+            parser.error('--max-bandwidth needs --image-size')
+
+    loop = asyncio.new_event_loop()
+    asyncio.set_event_loop(loop)
+    task = loop.create_task(rollout(args))
+    loop.add_signal_handler(signal.SIGINT, task.cancel)
+    try:
+        sys.exit(loop.run_until_complete(task))
+    except asyncio.CancelledError:
+        print('Script aborted')
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
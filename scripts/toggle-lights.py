@@ -15,6 +15,8 @@ import datetime
 # Script Version 1.1
 
 headers = { 'Content-Type': 'application/json'}
+# LwM2M content format Leshan asks devices for
+content_format = 'TLV'
 thread_wait = .25
 
 logging.basicConfig(level=logging.INFO,
@@ -70,7 +72,8 @@ def post(url):
         return False
 
 def get(url, raw=False):
-    response = requests.get(url, headers=headers)
+    response = requests.get(url, headers=headers,
+                            params={'format': content_format})
     if response.status_code in (200, 201):
         try:
             payload = json.loads(response.content)
@@ -171,7 +174,10 @@ def main():
     parser.add_argument('-t', '--threads', help='Maximum threads', default=1)
     parser.add_argument('-l', '--loops', help='Number of loop executions', default=0)
     parser.add_argument('-w', '--wait', help='Wait delay between loops (in seconds)', default=1)
+    parser.add_argument('-f', '--format', help='Content format for reads', default='TLV')
     args = parser.parse_args()
+    global content_format
+    content_format = args.format
     logging.info('client:%s hostname:%s device:%s threads:%d loops:%d delay:%d',
         args.client, args.hostname, args.device, int(args.threads), int(args.loops), int(args.wait))
     run(args.client, args.hostname, args.device, int(args.threads), int(args.loops), int(args.wait))
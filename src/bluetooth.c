@@ -29,6 +29,17 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 #include <bluetooth/conn.h>
 
 #include "product_id.h"
+#include "settings.h"
+#include "bt_link_policy.h"
+
+static u32_t reconnects;
+static bool link_lost;
+static struct k_work reboot_work;
+
+#if defined(CONFIG_FOTA_BT_RECONNECT)
+static struct k_work advertise_work;
+static struct k_delayed_work reconnect_timeout_work;
+#endif
 
 static void set_own_bt_addr(bt_addr_le_t *addr)
 {
@@ -69,22 +80,85 @@ static void set_bluetooth_led(bool state)
 #endif
 }
 
+/*
+ * Runs on the system work queue: saving the count writes flash, which
+ * the Bluetooth callbacks must not wait for.
+ */
+static void link_lost_reboot(struct k_work *work)
+{
+	int ret;
+
+	ret = fota_bt_reboot_count_increment();
+	if (ret) {
+		LOG_ERR("Failed to save BT reboot count: %d", ret);
+	}
+
+	LOG_PANIC();
+	sys_reboot(0);
+}
+
+#if defined(CONFIG_FOTA_BT_RECONNECT)
+static void advertise(struct k_work *work)
+{
+	/* TODO: use a better way to select BT interface */
+	struct net_if *iface = net_if_get_default();
+	int ret;
+
+	ret = net_mgmt(NET_REQUEST_BT_ADVERTISE, iface, "on", 0);
+	if (ret < 0) {
+		LOG_ERR("Error restarting advertise:%d", ret);
+	}
+}
+
+static void reconnect_timeout(struct k_work *work)
+{
+	LOG_ERR("No BT LE reconnect after %d s, rebooting!",
+		CONFIG_FOTA_BT_RECONNECT_TIMEOUT);
+	link_lost_reboot(work);
+}
+#endif
+
 static void connected(struct bt_conn *conn, u8_t err)
 {
 	if (err) {
 		LOG_ERR("BT LE Connection failed: %u", err);
-	} else {
+		return;
+	}
+
+	set_bluetooth_led(1);
+	bt_link_policy_connected(conn);
+
+	if (!link_lost) {
 		LOG_INF("BT LE Connected");
-		set_bluetooth_led(1);
+		return;
 	}
+
+	link_lost = false;
+	reconnects++;
+#if defined(CONFIG_FOTA_BT_RECONNECT)
+	k_delayed_work_cancel(&reconnect_timeout_work);
+#endif
+	/* The LwM2M session is resumed once the interface is back up */
+	LOG_INF("BT LE Reconnected (%u reconnects, %u reboots)",
+		reconnects, fota_bt_reboot_count_read());
 }
 
 static void disconnected(struct bt_conn *conn, u8_t reason)
 {
-	LOG_ERR("BT LE Disconnected (reason %u), rebooting!", reason);
 	set_bluetooth_led(0);
-	LOG_PANIC();
-	sys_reboot(0);
+	bt_link_policy_disconnected(conn);
+	link_lost = true;
+
+#if defined(CONFIG_FOTA_BT_RECONNECT)
+	LOG_WRN("BT LE Disconnected (reason %u), waiting for reconnect",
+		reason);
+	k_work_submit(&advertise_work);
+	k_delayed_work_submit(&reconnect_timeout_work,
+			      K_SECONDS(CONFIG_FOTA_BT_RECONNECT_TIMEOUT));
+#else
+	LOG_ERR("BT LE Disconnected (reason %u), rebooting!", reason);
+	k_work_submit(&reboot_work);
+#endif
 }
 
 static struct bt_conn_cb conn_callbacks = {
@@ -110,9 +184,21 @@ static int bt_network_init(struct device *dev)
 	ret = bt_set_id_addr(&bt_addr);
 	bt_conn_cb_register(&conn_callbacks);
 
+	k_work_init(&reboot_work, link_lost_reboot);
+#if defined(CONFIG_FOTA_BT_RECONNECT)
+	k_work_init(&advertise_work, advertise);
+	k_delayed_work_init(&reconnect_timeout_work, reconnect_timeout);
+#endif
+
 	return ret;
 }
 
+void bt_network_stats_get(struct bt_network_stats *stats)
+{
+	stats->reconnects = reconnects;
+	stats->reboots = fota_bt_reboot_count_read();
+}
+
 int bt_network_disable(void)
 {
 	/* TODO: use a better way to select BT interface */
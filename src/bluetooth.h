@@ -7,6 +7,16 @@
 #ifndef FOTA_BLUETOOTH_H__
 #define FOTA_BLUETOOTH_H__
 
+#include <zephyr/types.h>
+
+struct bt_network_stats {
+	/** Links re-established without a reboot since boot */
+	u32_t reconnects;
+	/** Reboots caused by a lost link, persisted across boots */
+	u32_t reboots;
+};
+
 int bt_network_disable(void);
+void bt_network_stats_get(struct bt_network_stats *stats);
 
 #endif	/* FOTA_BLUETOOTH_H__ */
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_bt_link
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+
+#include "bt_link_policy.h"
+
+static struct bt_conn *link_conn;
+static bool fota_active;
+
+/*
+ * HCI commands block waiting for the controller, so don't issue them
+ * from the Bluetooth callbacks: use the system work queue instead.
+ */
+static struct k_work link_params_work;
+
+static void link_params_update(struct k_work *work)
+{
+	struct bt_le_conn_param param;
+	struct bt_conn *conn = link_conn;
+	int ret;
+
+	if (!conn) {
+		return;
+	}
+
+	if (fota_active) {
+		param.interval_min = CONFIG_FOTA_BT_LINK_FAST_INTERVAL;
+		param.interval_max = CONFIG_FOTA_BT_LINK_FAST_INTERVAL;
+		param.latency = 0;
+	} else {
+		param.interval_min = CONFIG_FOTA_BT_LINK_IDLE_INTERVAL_MIN;
+		param.interval_max = CONFIG_FOTA_BT_LINK_IDLE_INTERVAL_MAX;
+		param.latency = CONFIG_FOTA_BT_LINK_IDLE_LATENCY;
+	}
+	param.timeout = CONFIG_FOTA_BT_LINK_TIMEOUT;
+
+	ret = bt_conn_le_param_update(conn, &param);
+	if (ret) {
+		LOG_WRN("Connection parameter update failed: %d", ret);
+		return;
+	}
+
+	LOG_DBG("Requested %s connection interval %u-%u",
+		fota_active ? "fast" : "idle",
+		param.interval_min, param.interval_max);
+}
+
+void bt_link_policy_connected(struct bt_conn *conn)
+{
+	if (link_conn) {
+		bt_conn_unref(link_conn);
+	}
+	link_conn = bt_conn_ref(conn);
+
+	k_work_submit(&link_params_work);
+}
+
+void bt_link_policy_disconnected(struct bt_conn *conn)
+{
+	if (link_conn != conn) {
+		return;
+	}
+
+	bt_conn_unref(link_conn);
+	link_conn = NULL;
+}
+
+void bt_link_policy_fota(bool active)
+{
+	if (fota_active == active) {
+		return;
+	}
+
+	fota_active = active;
+	k_work_submit(&link_params_work);
+}
+
+static int bt_link_policy_init(struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	k_work_init(&link_params_work, link_params_update);
+
+	return 0;
+}
+
+SYS_INIT(bt_link_policy_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
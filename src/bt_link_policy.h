@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_BT_LINK_POLICY_H__
+#define FOTA_BT_LINK_POLICY_H__
+
+/**
+ * @file
+ * @brief Bluetooth link policy
+ *
+ * Switches between fast and power-saving connection parameters
+ * depending on whether a firmware download is running.
+ */
+
+#include <zephyr/types.h>
+
+struct bt_conn;
+
+#if defined(CONFIG_FOTA_BT_LINK_POLICY)
+
+/**
+ * @brief Apply the link policy to a new connection.
+ * @param conn Connection which was just established.
+ */
+void bt_link_policy_connected(struct bt_conn *conn);
+
+/**
+ * @brief Forget about a connection which went away.
+ * @param conn Connection which was just lost.
+ */
+void bt_link_policy_disconnected(struct bt_conn *conn);
+
+/**
+ * @brief Report the start or end of a firmware download.
+ * @param active true while blocks are being received.
+ */
+void bt_link_policy_fota(bool active);
+
+#else
+
+static inline void bt_link_policy_connected(struct bt_conn *conn) {}
+static inline void bt_link_policy_disconnected(struct bt_conn *conn) {}
+static inline void bt_link_policy_fota(bool active) {}
+
+#endif /* CONFIG_FOTA_BT_LINK_POLICY */
+
+#endif	/* FOTA_BT_LINK_POLICY_H__ */
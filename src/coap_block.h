@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_COAP_BLOCK_H__
+#define FOTA_COAP_BLOCK_H__
+
+/**
+ * @file
+ * @brief CoAP block-wise transfer helpers
+ *
+ * Block size and Block1/Block2 option encoding (RFC 7959) shared by
+ * the application's own CoAP endpoints, the group receiver
+ * (group_fota.c) and the peer image server (peer_server.c). Both move
+ * firmware in the same block size as the LwM2M engine.
+ */
+
+/** Firmware block size, the LwM2M engine's CoAP block size */
+#define FOTA_BLOCK_SIZE		CONFIG_LWM2M_COAP_BLOCK_SIZE
+
+/** SZX field encoding FOTA_BLOCK_SIZE */
+#define FOTA_BLOCK_SZX		(__builtin_ctz(FOTA_BLOCK_SIZE) - 4)
+
+/** Size in bytes of the blocks of a given SZX */
+#define FOTA_BLOCK_SZX_SIZE(szx)	(1 << ((szx) + 4))
+
+/** Fields of a Block1/Block2 option value */
+#define FOTA_BLOCK_OPT_NUM(opt)		((opt) >> 4)
+#define FOTA_BLOCK_OPT_SZX(opt)		((opt) & 0x7)
+
+/** Block1/Block2 option value */
+#define FOTA_BLOCK_OPT(num, more, szx)	((num) << 4 | (more) << 3 | (szx))
+
+/** Room for the CoAP header and options in front of a block */
+#define FOTA_COAP_OVERHEAD	64
+
+#endif	/* FOTA_COAP_BLOCK_H__ */
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_governor
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <init.h>
+#include <net/socket.h>
+#include <net/lwm2m.h>
+
+#include "lwm2m_object.h"
+#include "lwm2m_engine.h"
+
+#include "fota_governor.h"
+
+#define GOVERNOR_OBJECT_ID		26242
+
+#define GOVERNOR_MAX_BLOCK_RATE_ID	0
+#define GOVERNOR_MAX_FLASH_DUTY_ID	1
+#define GOVERNOR_RATE_ID		2
+#define GOVERNOR_YIELDS_ID		3
+
+#define GOVERNOR_MAX_ID			4
+
+/* weight of the newest sample in the rate average, in 1/8ths */
+#define RATE_EWMA_WEIGHT		2
+
+/*
+ * This runs in the engine's receive thread, and the block can't be
+ * taken later: the wait delays the ACK, and with it the next block.
+ * Each wait is capped at one round trip, so the thread is never held
+ * much longer than the transfer itself takes, and at this bound to
+ * stay under the CoAP ACK timeout (2 s).
+ */
+#define GOVERNOR_MAX_WAIT_MS		1000
+
+static struct lwm2m_ctx *client_ctx;
+
+/* policy */
+static u16_t max_block_rate = CONFIG_FOTA_GOVERNOR_MAX_BLOCKS_PER_SEC;
+static u8_t max_flash_duty = CONFIG_FOTA_GOVERNOR_FLASH_DUTY_PERCENT;
+
+/* state of the current download */
+static s64_t last_block_time;
+static u32_t flash_busy_ms;
+/* round trip between blocks, without our own waiting and flash time */
+static s32_t rtt_ms;
+static u32_t rate;
+static u32_t yields;
+
+static struct lwm2m_engine_obj governor_obj;
+static struct lwm2m_engine_obj_field fields[] = {
+	OBJ_FIELD_DATA(GOVERNOR_MAX_BLOCK_RATE_ID, RW, U16),
+	OBJ_FIELD_DATA(GOVERNOR_MAX_FLASH_DUTY_ID, RW, U8),
+	OBJ_FIELD_DATA(GOVERNOR_RATE_ID, R, U32),
+	OBJ_FIELD_DATA(GOVERNOR_YIELDS_ID, R, U32),
+};
+
+static struct lwm2m_engine_obj_inst inst;
+static struct lwm2m_engine_res_inst res[GOVERNOR_MAX_ID];
+
+/*
+ * Sleep for up to timeout ms, but return as soon as something is
+ * waiting on the LwM2M socket: interactive requests win over FOTA.
+ */
+static bool wait_or_yield(s32_t timeout)
+{
+	struct pollfd fds;
+
+	if (!client_ctx || client_ctx->sock_fd < 0) {
+		k_sleep(timeout);
+		return false;
+	}
+
+	fds.fd = client_ctx->sock_fd;
+	fds.events = POLLIN;
+	fds.revents = 0;
+
+	return poll(&fds, 1, timeout) > 0;
+}
+
+void fota_governor_block(size_t len)
+{
+	s64_t now = k_uptime_get();
+	s32_t delay = 0, elapsed, rtt;
+	u32_t sample;
+
+	if (!last_block_time) {
+		last_block_time = now;
+		return;
+	}
+
+	elapsed = (s32_t)(now - last_block_time);
+
+	/* elapsed counts from after the last wait */
+	rtt = MAX(elapsed - (s32_t)flash_busy_ms, 1);
+	rtt_ms = rtt_ms ? (rtt_ms * (8 - RATE_EWMA_WEIGHT) +
+			   rtt * RATE_EWMA_WEIGHT) / 8 : rtt;
+
+	if (max_block_rate) {
+		delay = MSEC_PER_SEC / max_block_rate - elapsed;
+	}
+
+	/* idle time needed so flash stays under its duty cycle */
+	if (max_flash_duty < 100 && flash_busy_ms) {
+		delay = MAX(delay, (s32_t)(flash_busy_ms *
+					   (100 - max_flash_duty) /
+					   max_flash_duty) - elapsed);
+	}
+	flash_busy_ms = 0;
+
+	delay = MIN(delay, MIN(rtt_ms, GOVERNOR_MAX_WAIT_MS));
+	if (delay > 0 && wait_or_yield(delay)) {
+		yields++;
+	}
+
+	now = k_uptime_get();
+	elapsed = MAX((s32_t)(now - last_block_time), 1);
+	last_block_time = now;
+
+	sample = len * MSEC_PER_SEC / elapsed;
+	rate = rate ? (rate * (8 - RATE_EWMA_WEIGHT) +
+		       sample * RATE_EWMA_WEIGHT) / 8 : sample;
+}
+
+void fota_governor_flash_busy(u32_t ms)
+{
+	flash_busy_ms += ms;
+}
+
+void fota_governor_reset(void)
+{
+	last_block_time = 0;
+	flash_busy_ms = 0;
+	rtt_ms = 0;
+	rate = 0;
+}
+
+static int max_flash_duty_cb(u16_t obj_inst_id, u8_t *data, u16_t data_len,
+			     bool last_block, size_t total_size)
+{
+	if (max_flash_duty == 0 || max_flash_duty > 100) {
+		LOG_WRN("Invalid flash duty cycle %u%%, using 100%%",
+			max_flash_duty);
+		max_flash_duty = 100;
+	}
+
+	return 0;
+}
+
+static struct lwm2m_engine_obj_inst *governor_create(u16_t obj_inst_id)
+{
+	int i = 0;
+
+	if (obj_inst_id != 0) {
+		LOG_ERR("Only instance 0 is supported");
+		return NULL;
+	}
+
+	INIT_OBJ_RES_DATA(res, i, GOVERNOR_MAX_BLOCK_RATE_ID,
+			  &max_block_rate, sizeof(max_block_rate));
+	INIT_OBJ_RES_DATA(res, i, GOVERNOR_MAX_FLASH_DUTY_ID,
+			  &max_flash_duty, sizeof(max_flash_duty));
+	INIT_OBJ_RES_DATA(res, i, GOVERNOR_RATE_ID, &rate, sizeof(rate));
+	INIT_OBJ_RES_DATA(res, i, GOVERNOR_YIELDS_ID, &yields, sizeof(yields));
+
+	inst.resources = res;
+	inst.resource_count = i;
+
+	return &inst;
+}
+
+int fota_governor_init(struct lwm2m_ctx *ctx)
+{
+	int ret;
+
+	client_ctx = ctx;
+
+	ret = lwm2m_engine_create_obj_inst(STRINGIFY(GOVERNOR_OBJECT_ID) "/0");
+	if (ret < 0) {
+		LOG_ERR("Failed to create governor object: %d", ret);
+		return ret;
+	}
+
+	return lwm2m_engine_register_post_write_callback(
+		STRINGIFY(GOVERNOR_OBJECT_ID) "/0/"
+		STRINGIFY(GOVERNOR_MAX_FLASH_DUTY_ID), max_flash_duty_cb);
+}
+
+static int governor_obj_init(struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	governor_obj.obj_id = GOVERNOR_OBJECT_ID;
+	governor_obj.fields = fields;
+	governor_obj.field_count = ARRAY_SIZE(fields);
+	governor_obj.max_instance_count = 1;
+	governor_obj.create_cb = governor_create;
+	lwm2m_register_obj(&governor_obj);
+
+	return 0;
+}
+
+SYS_INIT(governor_obj_init, APPLICATION, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_GOVERNOR_H__
+#define FOTA_GOVERNOR_H__
+
+/**
+ * @file
+ * @brief FOTA download rate governor
+ *
+ * Caps the firmware block rate and the share of time spent on flash
+ * operations during a download. The policy lives in vendor LwM2M
+ * object 26242:
+ *
+ * - 0: maximum blocks per second, 0 for unlimited (RW)
+ * - 1: maximum flash duty cycle in percent (RW)
+ * - 2: current download rate in bytes per second (R)
+ * - 3: number of times pacing yielded to a pending request (R)
+ */
+
+#include <zephyr/types.h>
+
+struct lwm2m_ctx;
+
+#if defined(CONFIG_FOTA_GOVERNOR)
+
+/**
+ * @brief Initialize the governor.
+ *
+ * @param ctx LwM2M client context, used to detect pending requests.
+ * @return 0 on success, negative errno otherwise.
+ */
+int fota_governor_init(struct lwm2m_ctx *ctx);
+
+/**
+ * @brief Wait until the policy allows the next firmware block.
+ *
+ * Returns early if a request is waiting on the LwM2M socket, and never
+ * waits longer than the round trip between blocks (nor a second). A
+ * limit which would need longer waits is not reached: the block rate
+ * only drops to about half of what the link allows.
+ *
+ * @param len Size of the block about to be written.
+ */
+void fota_governor_block(size_t len);
+
+/**
+ * @brief Account time spent erasing or programming flash.
+ *
+ * Only per-block work belongs here: a one-time erase of the whole bank
+ * would turn into a wait the transfer can't survive.
+ *
+ * @param ms Flash busy time, in milliseconds.
+ */
+void fota_governor_flash_busy(u32_t ms);
+
+/**
+ * @brief Forget the state of the current download.
+ */
+void fota_governor_reset(void);
+
+#else
+
+static inline int fota_governor_init(struct lwm2m_ctx *ctx)
+{
+	return 0;
+}
+
+static inline void fota_governor_block(size_t len) {}
+static inline void fota_governor_flash_busy(u32_t ms) {}
+static inline void fota_governor_reset(void) {}
+
+#endif /* CONFIG_FOTA_GOVERNOR */
+
+#endif	/* FOTA_GOVERNOR_H__ */
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * "fota" shell commands, one per module which keeps statistics.
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <shell/shell.h>
+
+#include "reconnect.h"
+#if defined(CONFIG_FOTA_NET_STATS)
+#include "net_stats.h"
+#endif
+#if defined(CONFIG_NET_L2_BT)
+#include "bluetooth.h"
+#endif
+#if defined(CONFIG_FOTA_SERVER_FAILOVER)
+#include "server_failover.h"
+#endif
+
+#if defined(CONFIG_FOTA_NET_STATS)
+static int cmd_net_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	const struct net_stats_pool_data *data;
+	int i;
+
+	if (argc > 1) {
+		if (!strcmp(argv[1], "on")) {
+			net_stats_sampling(true);
+		} else if (!strcmp(argv[1], "off")) {
+			net_stats_sampling(false);
+		} else {
+			shell_error(shell, "Usage: net_stats [on|off]");
+			return -EINVAL;
+		}
+		return 0;
+	}
+
+	shell_print(shell, "Sampling every %d ms: %s",
+		    CONFIG_FOTA_NET_STATS_INTERVAL_MS,
+		    net_stats_is_sampling() ? "on" : "off");
+	shell_print(shell, "Estimates: bursts between samples and failed "
+		    "allocations are not counted");
+	shell_print(shell, "%-16s %5s %5s %5s %9s %12s", "Pool", "Size",
+		    "Used", "Max", "Exhausted", "Empty (ms)");
+	for (i = 0; i < NET_STATS_POOL_COUNT; i++) {
+		data = net_stats_get(i);
+		shell_print(shell, "%-16s %5u %5u %5u %9u %12u",
+			    net_stats_pool_name(i), data->size, data->used,
+			    data->max_used, data->exhausted,
+			    data->exhausted_ms);
+	}
+
+	return 0;
+}
+
+#define FOTA_CMD_NET_STATS						\
+	SHELL_CMD_ARG(net_stats, NULL,					\
+		      "Network buffer pool statistics [on|off]",	\
+		      cmd_net_stats, 1, 1),
+#else
+#define FOTA_CMD_NET_STATS
+#endif /* CONFIG_FOTA_NET_STATS */
+
+static int cmd_reconnect(const struct shell *shell, size_t argc, char **argv)
+{
+	struct reconnect_stats stats;
+
+	reconnect_stats_get(&stats);
+	shell_print(shell, "Attempts:       %u", stats.attempts);
+	shell_print(shell, "Failures:       %u", stats.failures);
+	shell_print(shell, "Failure streak: %u", stats.streak);
+	shell_print(shell, "Last delay:     %u ms", stats.last_delay_ms);
+
+	return 0;
+}
+
+#if defined(CONFIG_NET_L2_BT)
+static int cmd_bt(const struct shell *shell, size_t argc, char **argv)
+{
+	struct bt_network_stats stats;
+
+	bt_network_stats_get(&stats);
+	shell_print(shell, "Reconnects: %u", stats.reconnects);
+	shell_print(shell, "Reboots:    %u", stats.reboots);
+
+	return 0;
+}
+
+#define FOTA_CMD_BT							\
+	SHELL_CMD(bt, NULL, "Bluetooth link statistics", cmd_bt),
+#else
+#define FOTA_CMD_BT
+#endif /* CONFIG_NET_L2_BT */
+
+#if defined(CONFIG_FOTA_SERVER_FAILOVER)
+static int cmd_failover(const struct shell *shell, size_t argc, char **argv)
+{
+	static const char * const names[SERVER_COUNT] = {
+		[SERVER_PRIMARY] = "primary",
+		[SERVER_SECONDARY] = "secondary",
+	};
+	struct server_health h;
+	int i;
+
+	shell_print(shell, "Current: %s", names[server_failover_current()]);
+	shell_print(shell, "%-10s %8s %13s %8s %6s", "Server", "RTT (ms)",
+		    "Registrations", "Failures", "Streak");
+	for (i = 0; i < SERVER_COUNT; i++) {
+		server_failover_health_get(i, &h);
+		shell_print(shell, "%-10s %8u %13u %8u %6u", names[i],
+			    h.rtt_ms, h.registrations, h.failures,
+			    h.streak);
+	}
+
+	return 0;
+}
+
+#define FOTA_CMD_FAILOVER						\
+	SHELL_CMD(failover, NULL, "LwM2M server failover health",	\
+		  cmd_failover),
+#else
+#define FOTA_CMD_FAILOVER
+#endif /* CONFIG_FOTA_SERVER_FAILOVER */
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_fota,
+	FOTA_CMD_NET_STATS
+	FOTA_CMD_BT
+	FOTA_CMD_FAILOVER
+	SHELL_CMD(reconnect, NULL, "LwM2M server reconnect statistics",
+		  cmd_reconnect),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(fota, &sub_fota, "FOTA application commands", NULL);
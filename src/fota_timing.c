@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_timing
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <net/lwm2m.h>
+
+#include "fota_timing.h"
+
+static s64_t download_start;
+static u32_t erase_ms;
+static u32_t write_ms;
+static bool registered;
+
+void fota_timing_download_start(void)
+{
+	download_start = k_uptime_get();
+	erase_ms = 0;
+	write_ms = 0;
+}
+
+void fota_timing_erase(u32_t ms)
+{
+	erase_ms += ms;
+}
+
+void fota_timing_write(u32_t ms)
+{
+	write_ms += ms;
+}
+
+void fota_timing_download_done(size_t bytes)
+{
+	LOG_INF("download bytes=%u ms=%u erase_ms=%u "
+		"write_ms=%u", (u32_t)bytes,
+		(u32_t)(k_uptime_get() - download_start), erase_ms, write_ms);
+}
+
+void fota_timing_registered(void)
+{
+	u8_t result = 0;
+
+	/* only the first registration measures the boot */
+	if (registered) {
+		return;
+	}
+	registered = true;
+
+	lwm2m_engine_get_u8("5/0/5", &result);
+	LOG_INF("registered boot_ms=%u result=%u",
+		k_uptime_get_32(), result);
+}
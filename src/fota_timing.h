@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_TIMING_H__
+#define FOTA_TIMING_H__
+
+/**
+ * @file
+ * @brief FOTA timing records, for benchmarks
+ *
+ * Logs one line per firmware download and one per boot, from the
+ * fota_timing log module, in a fixed "key=value" format which
+ * scripts/fota_soak.py parses:
+ *
+ *   download bytes=<n> ms=<n> erase_ms=<n> write_ms=<n>
+ *   registered boot_ms=<n> result=<5/0/5>
+ */
+
+#include <zephyr/types.h>
+
+#if defined(CONFIG_FOTA_TIMING)
+
+/**
+ * @brief Start timing a download, at its first block.
+ */
+void fota_timing_download_start(void);
+
+/**
+ * @brief Account time spent erasing flash.
+ * @param ms Erase time, in milliseconds.
+ */
+void fota_timing_erase(u32_t ms);
+
+/**
+ * @brief Account time spent programming flash.
+ * @param ms Write time, in milliseconds.
+ */
+void fota_timing_write(u32_t ms);
+
+/**
+ * @brief Log the download record, after its last block.
+ * @param bytes Size of the download.
+ */
+void fota_timing_download_done(size_t bytes);
+
+/**
+ * @brief Log the boot record, at the first registration after boot.
+ */
+void fota_timing_registered(void);
+
+#else
+
+static inline void fota_timing_download_start(void) {}
+static inline void fota_timing_erase(u32_t ms) {}
+static inline void fota_timing_write(u32_t ms) {}
+static inline void fota_timing_download_done(size_t bytes) {}
+static inline void fota_timing_registered(void) {}
+
+#endif /* CONFIG_FOTA_TIMING */
+
+#endif	/* FOTA_TIMING_H__ */
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_write
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <dfu/mcuboot.h>
+#include <flash.h>
+
+#include "lwm2m.h"
+#include "bt_link_policy.h"
+#include "fota_governor.h"
+#include "fota_timing.h"
+#include "fota_write.h"
+#include "group_fota.h"
+#include "log_throttle.h"
+
+#define FLASH_BANK1_ID DT_FLASH_AREA_IMAGE_1_ID
+#define FLASH_BANK_SIZE DT_FLASH_AREA_IMAGE_1_SIZE
+
+static struct device *flash_dev;
+
+/*
+ * storage location for firmware package: blocks are programmed
+ * straight from here, so it must hold whole flash write blocks
+ */
+static u8_t firmware_buf[FOTA_WRITE_BUF_SIZE];
+/* bytes of the firmware package programmed into bank 1 so far */
+static size_t firmware_bytes_written;
+
+BUILD_ASSERT_MSG(FOTA_WRITE_BUF_SIZE % DT_FLASH_WRITE_BLOCK_SIZE == 0,
+		 "Block buffer size must be a multiple of the flash write block size");
+
+void fota_write_init(struct device *dev)
+{
+	flash_dev = dev;
+}
+
+void *fota_write_get_buf(u16_t obj_inst_id, size_t *data_len)
+{
+	*data_len = sizeof(firmware_buf);
+	return firmware_buf;
+}
+
+/* Bank 1 is erased before it is written: erased bytes need no write. */
+static bool block_is_blank(const u8_t *data, size_t len)
+{
+	while (len--) {
+		if (*data++ != 0xff) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Program a firmware block into bank 1 directly from the buffer the
+ * LwM2M engine received it into. All blocks but the last one are a
+ * multiple of the flash write block size; the last one is padded with
+ * erased flash bytes. Blank blocks (all 0xff, e.g. padding between
+ * image sections) are skipped.
+ */
+static int firmware_flash_write(u8_t *data, u16_t data_len, bool last_block)
+{
+	size_t len = data_len;
+	u32_t busy_ms;
+	s64_t start;
+	int ret;
+
+	if (len % DT_FLASH_WRITE_BLOCK_SIZE) {
+		if (!last_block) {
+			LOG_ERR("Unaligned firmware block (%u bytes)",
+				data_len);
+			return -EINVAL;
+		}
+
+		/* pad in firmware_buf, which has room for a full block */
+		if (data != firmware_buf) {
+			memmove(firmware_buf, data, data_len);
+			data = firmware_buf;
+		}
+		len = ROUND_UP(len, DT_FLASH_WRITE_BLOCK_SIZE);
+		memset(data + data_len, 0xff, len - data_len);
+	}
+
+	if (block_is_blank(data, len)) {
+		firmware_bytes_written += len;
+		return 0;
+	}
+
+	start = k_uptime_get();
+	flash_write_protection_set(flash_dev, false);
+	ret = flash_write(flash_dev,
+			  DT_FLASH_AREA_IMAGE_1_OFFSET + firmware_bytes_written,
+			  data, len);
+	flash_write_protection_set(flash_dev, true);
+	busy_ms = k_uptime_delta_32(&start);
+	fota_governor_flash_busy(busy_ms);
+	fota_timing_write(busy_ms);
+	if (ret) {
+		return ret;
+	}
+
+	firmware_bytes_written += len;
+
+	return 0;
+}
+
+int fota_write_block(u16_t obj_inst_id, u8_t *data, u16_t data_len,
+		     bool last_block, size_t total_size)
+{
+#if defined(CONFIG_FOTA_ERASE_PROGRESSIVELY)
+	static int last_offset = DT_FLASH_AREA_IMAGE_1_OFFSET;
+#endif
+	static u8_t percent_downloaded;
+	static u32_t bytes_downloaded;
+	u8_t downloaded;
+	u32_t busy_ms;
+	s64_t start;
+	int ret = 0;
+
+	if (total_size > FLASH_BANK_SIZE) {
+		LOG_ERR("Artifact file size too big (%d)", total_size);
+		return -EINVAL;
+	}
+
+	if (!data_len) {
+		LOG_ERR("Data len is zero, nothing to write.");
+		return -EINVAL;
+	}
+
+	if (group_fota_active()) {
+		LOG_ERR("Group firmware transfer in progress, refusing block");
+		return -EBUSY;
+	}
+
+	/* Erase bank 1 before starting the write process */
+	if (bytes_downloaded == 0) {
+		lwm2m_slot1_cleanup_cancel();
+		bt_link_policy_fota(true);
+		fota_governor_reset();
+		fota_timing_download_start();
+		firmware_bytes_written = 0;
+#if defined(CONFIG_FOTA_ERASE_PROGRESSIVELY)
+		LOG_INF("Download firmware started, erasing progressively.");
+		/* reset image data */
+		ret = boot_invalidate_slot1();
+		if (ret != 0) {
+			LOG_ERR("Failed to reset image data in bank 1");
+			goto cleanup;
+		}
+#else
+		LOG_INF("Download firmware started, erasing second bank");
+		start = k_uptime_get();
+		ret = boot_erase_img_bank(FLASH_BANK1_ID);
+		busy_ms = k_uptime_delta_32(&start);
+		/* one-time cost, not charged to the governor's duty cycle */
+		fota_timing_erase(busy_ms);
+		if (ret != 0) {
+			LOG_ERR("Failed to erase flash bank 1");
+			goto cleanup;
+		}
+#endif
+	}
+
+	/* Leave room for interactive traffic before taking this block */
+	fota_governor_block(data_len);
+
+	bytes_downloaded += data_len;
+
+	/* display a % downloaded, if it's different */
+	if (total_size) {
+		downloaded = bytes_downloaded * 100 / total_size;
+	} else {
+		/* Total size is empty when there is only one block */
+		downloaded = 100;
+	}
+
+	if (downloaded > percent_downloaded) {
+		percent_downloaded = downloaded;
+		if (percent_downloaded == 100) {
+			LOG_INF("%d%%", percent_downloaded);
+		} else {
+			LOG_INF_THROTTLED("%d%%", percent_downloaded);
+		}
+	}
+
+#if defined(CONFIG_FOTA_ERASE_PROGRESSIVELY)
+	/* Erase the sector that's going to be written to next */
+	while (last_offset <
+	       DT_FLASH_AREA_IMAGE_1_OFFSET + firmware_bytes_written +
+	       DT_FLASH_ERASE_BLOCK_SIZE) {
+		LOG_INF_THROTTLED("Erasing sector at offset 0x%x",
+				  last_offset);
+		start = k_uptime_get();
+		flash_write_protection_set(flash_dev, false);
+		ret = flash_erase(flash_dev, last_offset,
+				  DT_FLASH_ERASE_BLOCK_SIZE);
+		flash_write_protection_set(flash_dev, true);
+		busy_ms = k_uptime_delta_32(&start);
+		fota_governor_flash_busy(busy_ms);
+		fota_timing_erase(busy_ms);
+		last_offset += DT_FLASH_ERASE_BLOCK_SIZE;
+		if (ret) {
+			LOG_ERR("Error %d while erasing sector", ret);
+			goto cleanup;
+		}
+	}
+#endif
+
+	ret = firmware_flash_write(data, data_len, last_block);
+	if (ret < 0) {
+		LOG_ERR("Failed to write flash block");
+		goto cleanup;
+	}
+
+	if (!last_block) {
+		/* Keep going */
+		return ret;
+	}
+
+	if (total_size && (bytes_downloaded != total_size)) {
+		LOG_ERR("Early last block, downloaded %d, expecting %d",
+			bytes_downloaded, total_size);
+		ret = -EIO;
+	} else {
+		fota_timing_download_done(bytes_downloaded);
+	}
+
+cleanup:
+#if defined(CONFIG_FOTA_ERASE_PROGRESSIVELY)
+	last_offset = DT_FLASH_AREA_IMAGE_1_OFFSET;
+#endif
+	bytes_downloaded = 0;
+	percent_downloaded = 0;
+	bt_link_policy_fota(false);
+
+	return ret;
+}
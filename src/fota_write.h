@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_WRITE_H__
+#define FOTA_WRITE_H__
+
+/**
+ * @file
+ * @brief Firmware image write path
+ *
+ * Erases image bank 1 and programs the blocks of a firmware download
+ * into it, as the LwM2M firmware object's write callback. Kept apart
+ * from lwm2m.c so it can be driven directly, e.g. by bench/fota_write.
+ */
+
+#include <zephyr/types.h>
+#include <device.h>
+
+/*
+ * Size of the block buffer handed to the LwM2M engine; a build
+ * without the engine (the benchmark) can set its own.
+ */
+#ifndef FOTA_WRITE_BUF_SIZE
+#define FOTA_WRITE_BUF_SIZE	CONFIG_LWM2M_COAP_BLOCK_SIZE
+#endif
+
+/**
+ * @brief Set the flash device holding the image banks.
+ */
+void fota_write_init(struct device *flash_dev);
+
+/**
+ * @brief Buffer the engine receives firmware blocks into.
+ *
+ * LwM2M pre-write callback of resource 5/0/0.
+ */
+void *fota_write_get_buf(u16_t obj_inst_id, size_t *data_len);
+
+/**
+ * @brief Write one firmware block into bank 1.
+ *
+ * LwM2M firmware write callback. The first block of a download
+ * erases the bank (all at once, or progressively with
+ * CONFIG_FOTA_ERASE_PROGRESSIVELY).
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int fota_write_block(u16_t obj_inst_id, u8_t *data, u16_t data_len,
+		     bool last_block, size_t total_size);
+
+#endif	/* FOTA_WRITE_H__ */
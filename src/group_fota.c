@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_group
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <flash.h>
+#include <net/socket.h>
+#include <net/net_if.h>
+#include <net/coap.h>
+#include <net/lwm2m.h>
+
+#include "lwm2m_object.h"
+
+#include "coap_block.h"
+#include "group_fota.h"
+#include "lwm2m.h"
+
+#define FW_PATH			"fw"
+
+#define BANK_OFFSET		DT_FLASH_AREA_IMAGE_1_OFFSET
+#define BANK_SIZE		DT_FLASH_AREA_IMAGE_1_SIZE
+#define SECTOR_SIZE		DT_FLASH_ERASE_BLOCK_SIZE
+
+#define MAX_BLOCKS		(BANK_SIZE / FOTA_BLOCK_SIZE)
+#define MAX_SECTORS		(BANK_SIZE / SECTOR_SIZE)
+
+BUILD_ASSERT_MSG(FOTA_BLOCK_SIZE % DT_FLASH_WRITE_BLOCK_SIZE == 0,
+		 "Block size must be a multiple of the flash write block size");
+BUILD_ASSERT_MSG(SECTOR_SIZE % FOTA_BLOCK_SIZE == 0,
+		 "Flash sectors must hold a whole number of blocks");
+
+struct group_session {
+	bool active;
+	bool repairing;
+	u8_t token[8];
+	u8_t tkl;
+	/* sender of the multicast, where repairs are requested from */
+	struct sockaddr_in6 sender;
+	size_t total_size;
+	u32_t block_count;
+	u32_t received_count;
+	/* block currently being repaired, and attempts so far */
+	u32_t repair_block;
+	u8_t repair_tries;
+	u8_t received[(MAX_BLOCKS + 7) / 8];
+	u8_t erased[(MAX_SECTORS + 7) / 8];
+};
+
+static struct group_session session;
+static struct device *flash_dev;
+static int sock = -1;
+static u8_t rx_buf[FOTA_BLOCK_SIZE + FOTA_COAP_OVERHEAD];
+static u8_t tx_buf[FOTA_COAP_OVERHEAD];
+
+static K_THREAD_STACK_DEFINE(group_fota_stack, CONFIG_FOTA_GROUP_STACK_SIZE);
+static struct k_thread group_fota_thread_data;
+
+static inline bool bit_test(const u8_t *map, u32_t bit)
+{
+	return map[bit / 8] & BIT(bit % 8);
+}
+
+static inline void bit_set(u8_t *map, u32_t bit)
+{
+	map[bit / 8] |= BIT(bit % 8);
+}
+
+static void session_abort(u8_t result)
+{
+	LOG_ERR("Group firmware transfer aborted (%u/%u blocks)",
+		session.received_count, session.block_count);
+	session.active = false;
+	lwm2m_firmware_set_update_result(result);
+}
+
+static int session_start(const u8_t *token, u8_t tkl, int size1,
+			 const struct sockaddr_in6 *from)
+{
+	u8_t state = lwm2m_firmware_get_update_state();
+
+	if (state != STATE_IDLE && !session.active) {
+		/* A regular LwM2M download owns bank 1 */
+		LOG_DBG("Firmware update busy (state %u), ignoring group",
+			state);
+		return -EBUSY;
+	}
+
+	if (size1 <= 0 || size1 > BANK_SIZE) {
+		LOG_ERR("Invalid group image size %d", size1);
+		return -EINVAL;
+	}
+
+	memset(&session, 0, sizeof(session));
+	memcpy(session.token, token, tkl);
+	session.tkl = tkl;
+	session.sender = *from;
+	session.total_size = size1;
+	session.block_count = DIV_ROUND_UP(size1, FOTA_BLOCK_SIZE);
+	session.active = true;
+
+	lwm2m_slot1_cleanup_cancel();
+	lwm2m_firmware_set_update_state(STATE_DOWNLOADING);
+
+	LOG_INF("Group firmware transfer started: %zu bytes, %u blocks",
+		session.total_size, session.block_count);
+
+	return 0;
+}
+
+/* Erase the sector holding offset, unless this transfer already did. */
+static int sector_prepare(off_t offset)
+{
+	u32_t sector = offset / SECTOR_SIZE;
+	int ret;
+
+	if (bit_test(session.erased, sector)) {
+		return 0;
+	}
+
+	flash_write_protection_set(flash_dev, false);
+	ret = flash_erase(flash_dev, BANK_OFFSET + sector * SECTOR_SIZE,
+			  SECTOR_SIZE);
+	flash_write_protection_set(flash_dev, true);
+	if (ret) {
+		LOG_ERR("Error %d while erasing sector %u", ret, sector);
+		return ret;
+	}
+
+	bit_set(session.erased, sector);
+
+	return 0;
+}
+
+static void session_complete(void)
+{
+	int ret;
+
+	/* Make sure no stale image trailer is left at the end of bank 1 */
+	ret = sector_prepare(BANK_SIZE - SECTOR_SIZE);
+	if (ret) {
+		session_abort(RESULT_INTEGRITY_FAILED);
+		return;
+	}
+
+	LOG_INF("Group firmware transfer complete (%u blocks)",
+		session.block_count);
+	session.active = false;
+	lwm2m_firmware_set_update_state(STATE_DOWNLOADED);
+}
+
+/*
+ * Write one block at its place in bank 1. payload points into rx_buf,
+ * which has room to pad the last block to the flash write block size.
+ */
+static int store_block(u32_t num, u8_t *payload, u16_t len)
+{
+	off_t offset = num * FOTA_BLOCK_SIZE;
+	size_t write_len = len;
+	int ret;
+
+	if (num >= session.block_count) {
+		LOG_WRN("Block %u out of range", num);
+		return -EINVAL;
+	}
+
+	if (bit_test(session.received, num)) {
+		return 0;
+	}
+
+	if (num < session.block_count - 1 ? len != FOTA_BLOCK_SIZE :
+	    len != session.total_size - offset) {
+		LOG_WRN("Block %u has a bad length (%u)", num, len);
+		return -EINVAL;
+	}
+
+	if (write_len % DT_FLASH_WRITE_BLOCK_SIZE) {
+		write_len = ROUND_UP(write_len, DT_FLASH_WRITE_BLOCK_SIZE);
+		if (payload + write_len > rx_buf + sizeof(rx_buf)) {
+			return -ENOMEM;
+		}
+		memset(payload + len, 0xff, write_len - len);
+	}
+
+	ret = sector_prepare(offset);
+	if (ret) {
+		return ret;
+	}
+
+	flash_write_protection_set(flash_dev, false);
+	ret = flash_write(flash_dev, BANK_OFFSET + offset, payload, write_len);
+	flash_write_protection_set(flash_dev, true);
+	if (ret) {
+		LOG_ERR("Failed to write block %u: %d", num, ret);
+		return ret;
+	}
+
+	bit_set(session.received, num);
+	session.received_count++;
+
+	return 0;
+}
+
+static int repair_request(u32_t num)
+{
+	struct coap_packet request;
+	int ret;
+
+	ret = coap_packet_init(&request, tx_buf, sizeof(tx_buf), 1,
+			       COAP_TYPE_CON, session.tkl, session.token,
+			       COAP_METHOD_GET, coap_next_id());
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = coap_packet_append_option(&request, COAP_OPTION_URI_PATH,
+					FW_PATH, strlen(FW_PATH));
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = coap_append_option_int(&request, COAP_OPTION_BLOCK2,
+				     FOTA_BLOCK_OPT(num, 0, FOTA_BLOCK_SZX));
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = sendto(sock, request.data, request.offset, 0,
+		     (struct sockaddr *)&session.sender,
+		     sizeof(session.sender));
+
+	return ret < 0 ? -errno : 0;
+}
+
+/* Ask the sender for the first block we don't have yet. */
+static void repair_next(void)
+{
+	u32_t num;
+	int ret;
+
+	for (num = 0; num < session.block_count; num++) {
+		if (!bit_test(session.received, num)) {
+			break;
+		}
+	}
+
+	if (num == session.block_count) {
+		session_complete();
+		return;
+	}
+
+	if (num == session.repair_block && session.repair_tries) {
+		if (session.repair_tries >= CONFIG_FOTA_GROUP_REPAIR_RETRIES) {
+			LOG_ERR("No answer for block %u", num);
+			session_abort(RESULT_CONNECTION_LOST);
+			return;
+		}
+	} else {
+		session.repair_block = num;
+		session.repair_tries = 0;
+	}
+
+	session.repair_tries++;
+	LOG_DBG("Requesting block %u (try %u)", num, session.repair_tries);
+	ret = repair_request(num);
+	if (ret < 0) {
+		LOG_ERR("Failed to send repair request: %d", ret);
+	}
+}
+
+static void handle_packet(u8_t *buf, size_t len,
+			  const struct sockaddr_in6 *from)
+{
+	struct coap_packet packet;
+	struct coap_option path;
+	u8_t token[8];
+	const u8_t *payload;
+	u16_t payload_len;
+	u8_t code, tkl;
+	int block, ret;
+	bool same_session;
+
+	ret = coap_packet_parse(&packet, buf, len, NULL, 0);
+	if (ret < 0) {
+		LOG_DBG("Dropping invalid CoAP packet");
+		return;
+	}
+
+	code = coap_header_get_code(&packet);
+	tkl = coap_header_get_token(&packet, token);
+	same_session = session.active && tkl == session.tkl &&
+		       !memcmp(token, session.token, tkl);
+
+	if (code == COAP_METHOD_PUT) {
+		/* multicast block */
+		ret = coap_find_options(&packet, COAP_OPTION_URI_PATH,
+					&path, 1);
+		if (ret != 1 || path.len != strlen(FW_PATH) ||
+		    memcmp(path.value, FW_PATH, path.len)) {
+			return;
+		}
+
+		block = coap_get_option_int(&packet, COAP_OPTION_BLOCK1);
+		if (!same_session &&
+		    session_start(token, tkl,
+				  coap_get_option_int(&packet,
+						      COAP_OPTION_SIZE1),
+				  from) < 0) {
+			return;
+		}
+	} else if (code == COAP_RESPONSE_CODE_CONTENT && same_session &&
+		   session.repairing) {
+		/* unicast repair */
+		block = coap_get_option_int(&packet, COAP_OPTION_BLOCK2);
+	} else {
+		return;
+	}
+
+	if (block < 0 || FOTA_BLOCK_OPT_SZX(block) != FOTA_BLOCK_SZX) {
+		LOG_WRN("Missing block option or bad block size");
+		return;
+	}
+
+	payload = coap_packet_get_payload(&packet, &payload_len);
+	if (!payload) {
+		return;
+	}
+
+	/* Malformed blocks are dropped, flash errors end the transfer */
+	ret = store_block(FOTA_BLOCK_OPT_NUM(block), (u8_t *)payload,
+			  payload_len);
+	if (ret < 0 && ret != -EINVAL) {
+		session_abort(RESULT_INTEGRITY_FAILED);
+		return;
+	}
+
+	if (session.received_count == session.block_count) {
+		session_complete();
+	} else if (session.repairing && code == COAP_RESPONSE_CODE_CONTENT) {
+		repair_next();
+	}
+}
+
+static void group_fota_thread(void *p1, void *p2, void *p3)
+{
+	struct sockaddr_in6 from;
+	socklen_t from_len;
+	struct pollfd fds;
+	int timeout, ret;
+
+	fds.fd = sock;
+	fds.events = POLLIN;
+
+	while (true) {
+		if (!session.active) {
+			timeout = -1;
+		} else if (session.repairing) {
+			timeout = CONFIG_FOTA_GROUP_REPAIR_TIMEOUT_MS;
+		} else {
+			timeout = CONFIG_FOTA_GROUP_IDLE_TIMEOUT_MS;
+		}
+
+		fds.revents = 0;
+		ret = poll(&fds, 1, timeout);
+		if (ret < 0) {
+			LOG_ERR("poll error: %d", -errno);
+			k_sleep(MSEC_PER_SEC);
+			continue;
+		}
+
+		if (ret == 0) {
+			/* the group went quiet, or a repair timed out */
+			session.repairing = true;
+			repair_next();
+			continue;
+		}
+
+		from_len = sizeof(from);
+		ret = recvfrom(sock, rx_buf, sizeof(rx_buf), 0,
+			       (struct sockaddr *)&from, &from_len);
+		if (ret <= 0) {
+			continue;
+		}
+
+		handle_packet(rx_buf, ret, &from);
+	}
+}
+
+bool group_fota_active(void)
+{
+	return session.active;
+}
+
+int group_fota_init(void)
+{
+	struct sockaddr_in6 addr;
+	struct net_if_mcast_addr *maddr;
+	struct net_if *iface = net_if_get_default();
+	struct in6_addr group;
+	int ret;
+
+	flash_dev = device_get_binding(DT_FLASH_DEV_NAME);
+	if (!flash_dev) {
+		LOG_ERR("missing flash device %s", DT_FLASH_DEV_NAME);
+		return -ENODEV;
+	}
+
+	ret = net_addr_pton(AF_INET6, CONFIG_FOTA_GROUP_ADDR, &group);
+	if (ret < 0) {
+		LOG_ERR("Invalid group address %s", CONFIG_FOTA_GROUP_ADDR);
+		return ret;
+	}
+
+	maddr = net_if_ipv6_maddr_add(iface, &group);
+	if (!maddr) {
+		LOG_ERR("Cannot join group %s", CONFIG_FOTA_GROUP_ADDR);
+		return -ENOMEM;
+	}
+	net_if_ipv6_maddr_join(maddr);
+
+	sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0) {
+		LOG_ERR("Failed to create socket: %d", -errno);
+		return -errno;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin6_family = AF_INET6;
+	addr.sin6_port = htons(CONFIG_FOTA_GROUP_PORT);
+	ret = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+	if (ret < 0) {
+		LOG_ERR("Failed to bind socket: %d", -errno);
+		close(sock);
+		sock = -1;
+		return -errno;
+	}
+
+	k_thread_create(&group_fota_thread_data, group_fota_stack,
+			K_THREAD_STACK_SIZEOF(group_fota_stack),
+			group_fota_thread, NULL, NULL, NULL,
+			K_LOWEST_APPLICATION_THREAD_PRIO, 0, K_NO_WAIT);
+
+	LOG_INF("Listening for group firmware on [%s]:%d",
+		CONFIG_FOTA_GROUP_ADDR, CONFIG_FOTA_GROUP_PORT);
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_GROUP_FOTA_H__
+#define FOTA_GROUP_FOTA_H__
+
+/**
+ * @file
+ * @brief Multicast group firmware transfer
+ *
+ * The sender multicasts the image to CONFIG_FOTA_GROUP_ADDR as
+ * non-confirmable CoAP PUT requests to "/fw". Each carries a Block1
+ * option with the block number and a Size1 option with the image
+ * size. The CoAP token identifies the transfer, and the block size
+ * must be CONFIG_LWM2M_COAP_BLOCK_SIZE.
+ *
+ * Once the group has been quiet for a while, the device requests any
+ * block it missed from the sender's unicast address: a confirmable
+ * GET to "/fw" with a Block2 option and the same token.
+ *
+ * Nothing authenticates the sender: whoever reaches the group can
+ * start a transfer and write bank 1, as long as no other update is in
+ * progress. MCUboot's signature check before booting is what keeps a
+ * forged image from running.
+ */
+
+#include <stdbool.h>
+
+#if defined(CONFIG_FOTA_GROUP)
+
+/**
+ * @brief Join the group and start receiving firmware images.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int group_fota_init(void);
+
+/**
+ * @brief Check whether a group transfer is writing bank 1.
+ *
+ * The regular download path must not touch bank 1 meanwhile.
+ */
+bool group_fota_active(void);
+
+#else
+
+static inline int group_fota_init(void)
+{
+	return 0;
+}
+
+static inline bool group_fota_active(void)
+{
+	return false;
+}
+
+#endif /* CONFIG_FOTA_GROUP */
+
+#endif	/* FOTA_GROUP_FOTA_H__ */
@@ -18,6 +18,31 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 #include <misc/printk.h>
 #include "product_id.h"
 
+#if defined(CONFIG_ARCH_POSIX)
+#include "cmdline.h"
+
+/* Simulated devices get their serial number from the command line */
+static u32_t sim_serial = 1;
+
+static void product_id_options(void)
+{
+	static struct args_struct_t options[] = {
+		{
+			.option = "serial",
+			.name = "number",
+			.type = 'u',
+			.dest = (void *)&sim_serial,
+			.descript = "Serial number of this simulated device",
+		},
+		ARG_TABLE_ENDMARKER
+	};
+
+	native_add_command_line_opts(options);
+}
+
+NATIVE_TASK(product_id_options, PRE_BOOT_1, 10);
+#endif
+
 /*
  * General hardware specific configs
  *
@@ -30,6 +55,9 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 #elif defined(CONFIG_SOC_SERIES_KINETIS_K6X)
 #define DEVICE_ID_BASE		(&SIM->UIDH)
 #define DEVICE_ID_LENGTH	4
+#elif defined(CONFIG_ARCH_POSIX)
+#define DEVICE_ID_BASE		(&sim_serial)
+#define DEVICE_ID_LENGTH	1
 #endif
 
 static struct product_id_t product_id = {
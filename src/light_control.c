@@ -15,7 +15,22 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 #include <gpio.h>
 #include <net/lwm2m.h>
 
+#include "lwm2m_object.h"
+#include "lwm2m_engine.h"
+
+#include "lwm2m_res_handle.h"
+
+#define IPSO_OBJECT_LIGHT_CONTROL_ID	3311
+#define ON_TIME_ID			5852
+
 /* Defines for the IPSO light-control elements */
+#if defined(CONFIG_FOTA_SIM)
+#include "sim/sim.h"
+
+#define LED_GPIO_PIN		SIM_LED_PIN
+#define LED_GPIO_FLAGS		0
+#define LED_GPIO_PORT		SIM_GPIO_NAME
+#else
 #define LED_GPIO_PIN		LED0_GPIO_PIN
 #define LED_GPIO_FLAGS		LED0_GPIO_FLAGS
 #if defined(LED0_GPIO_PORT)
@@ -23,9 +38,11 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 #else
 #define LED_GPIO_PORT		LED0_GPIO_CONTROLLER
 #endif
+#endif /* CONFIG_FOTA_SIM */
 
 static struct device *led_dev;
 static u8_t led_current;
+static struct lwm2m_res_handle on_time;
 
 /* TODO: Move to a pre write hook that can handle ret codes once available */
 static int on_off_cb(u16_t obj_inst_id, u8_t *data, u16_t data_len,
@@ -33,6 +50,7 @@ static int on_off_cb(u16_t obj_inst_id, u8_t *data, u16_t data_len,
 {
 	int ret = 0;
 	u8_t led_val;
+	s32_t reset = 0;
 
 	if (data_len != 1) {
 		LOG_ERR("Length of on_off callback data is incorrect! (%u)",
@@ -57,8 +75,11 @@ static int on_off_cb(u16_t obj_inst_id, u8_t *data, u16_t data_len,
 		}
 
 		led_current = led_val;
-		/* TODO: Move to be set by the IPSO object itself */
-		lwm2m_engine_set_s32("3311/0/5852", 0);
+		/*
+		 * TODO: Move to be set by the IPSO object itself.
+		 * The object's post-write hook restarts the on-time count.
+		 */
+		lwm2m_res_handle_set(&on_time, &reset, sizeof(reset));
 	}
 
 	return ret;
@@ -66,6 +87,7 @@ static int on_off_cb(u16_t obj_inst_id, u8_t *data, u16_t data_len,
 
 int init_light_control(void)
 {
+	struct lwm2m_engine_obj_inst *obj_inst;
 	int ret;
 
 	led_dev = device_get_binding(LED_GPIO_PORT);
@@ -92,7 +114,12 @@ int init_light_control(void)
 		goto fail;
 	}
 
-	ret = lwm2m_engine_create_obj_inst("3311/0");
+	ret = lwm2m_create_obj_inst(IPSO_OBJECT_LIGHT_CONTROL_ID, 0, &obj_inst);
+	if (ret < 0) {
+		goto fail;
+	}
+
+	ret = lwm2m_res_handle_init(&on_time, obj_inst, ON_TIME_ID);
 	if (ret < 0) {
 		goto fail;
 	}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Binary log backend: log messages go out on a UART as they were
+ * queued, the address of their format string and their arguments, and
+ * are formatted on the host by scripts/log_decode.py, from zephyr.elf.
+ *
+ * Frame: 0xff 0xa5, payload length, payload, sum of the payload bytes.
+ * Payload, little endian, starting with its type:
+ *   STD:     timestamp:4 source:2 domain<<3|level:1 fmt:4 nargs:1
+ *            then per argument, len:1 bytes for strings, else value:4
+ *   HEXDUMP: timestamp:4 source:2 domain<<3|level:1 fmt:4 len:1 bytes
+ *   CLOCK:   timestamp frequency:4
+ *   DROPPED: count:4
+ *
+ * printk() output is routed through the logger (CONFIG_LOG_PRINTK) and
+ * goes out as is, between frames; 0xff never shows up in it. Frames
+ * are only sent from the log thread, so they don't need a lock. Other
+ * console output, e.g. the shell, can still land inside a frame: the
+ * frame then fails its checksum and the decoder resyncs.
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <uart.h>
+#include <logging/log_backend.h>
+#include <logging/log_core.h>
+#include <logging/log_msg.h>
+
+#define FRAME_SYNC0		0xff
+#define FRAME_SYNC1		0xa5
+#define FRAME_MAX_PAYLOAD	255
+
+enum frame_type {
+	FRAME_STD,
+	FRAME_HEXDUMP,
+	FRAME_CLOCK,
+	FRAME_DROPPED,
+};
+
+static struct device *uart_dev;
+static u8_t payload[FRAME_MAX_PAYLOAD];
+static size_t payload_len;
+
+static void put_u8(u8_t value)
+{
+	if (payload_len < sizeof(payload)) {
+		payload[payload_len++] = value;
+	}
+}
+
+static void put_u16(u16_t value)
+{
+	put_u8(value);
+	put_u8(value >> 8);
+}
+
+static void put_u32(u32_t value)
+{
+	put_u16(value);
+	put_u16(value >> 16);
+}
+
+/* Length prefixed, cut to what is left of the payload */
+static void put_bytes(const u8_t *data, size_t len)
+{
+	size_t room = sizeof(payload) - MIN(payload_len + 1, sizeof(payload));
+
+	len = MIN(len, MIN(room, 255));
+	put_u8(len);
+	memcpy(&payload[payload_len], data, len);
+	payload_len += len;
+}
+
+static void frame_start(enum frame_type type)
+{
+	payload_len = 0;
+	put_u8(type);
+}
+
+static void frame_send(void)
+{
+	u8_t sum = 0;
+	size_t i;
+
+	uart_poll_out(uart_dev, FRAME_SYNC0);
+	uart_poll_out(uart_dev, FRAME_SYNC1);
+	uart_poll_out(uart_dev, payload_len);
+	for (i = 0; i < payload_len; i++) {
+		uart_poll_out(uart_dev, payload[i]);
+		sum += payload[i];
+	}
+	uart_poll_out(uart_dev, sum);
+}
+
+/* Which arguments of a format are strings, as a bit mask */
+static u32_t string_args(const char *fmt)
+{
+	u32_t mask = 0;
+	u32_t arg = 0;
+
+	for (; *fmt; fmt++) {
+		if (*fmt != '%') {
+			continue;
+		}
+		/* a lone '%' may end the format */
+		if (*++fmt == '\0') {
+			break;
+		}
+		if (*fmt == '%') {
+			continue;
+		}
+		while (*fmt && strchr("-+ #0123456789.*hlzjt", *fmt)) {
+			if (*fmt++ == '*') {
+				arg++;
+			}
+		}
+		if (*fmt == '\0') {
+			break;
+		}
+		if (*fmt == 's' && arg < 32) {
+			mask |= BIT(arg);
+		}
+		arg++;
+	}
+
+	return mask;
+}
+
+static void msg_header(struct log_msg *msg, enum frame_type type)
+{
+	frame_start(type);
+	put_u32(log_msg_timestamp_get(msg));
+	put_u16(log_msg_source_id_get(msg));
+	put_u8(log_msg_domain_id_get(msg) << 3 | log_msg_level_get(msg));
+	put_u32((u32_t)log_msg_str_get(msg));
+}
+
+static void put_std(struct log_msg *msg)
+{
+	u32_t strings = string_args(log_msg_str_get(msg));
+	u32_t nargs = log_msg_nargs_get(msg);
+	const char *str;
+	u32_t i, arg;
+
+	msg_header(msg, FRAME_STD);
+	put_u8(nargs);
+	for (i = 0; i < nargs; i++) {
+		arg = log_msg_arg_get(msg, i);
+		if (strings & BIT(i)) {
+			/*
+			 * Copy the string now: a log_strdup() buffer is
+			 * freed along with the message.
+			 */
+			str = (const char *)arg;
+			put_bytes((const u8_t *)str, str ? strlen(str) : 0);
+		} else {
+			put_u32(arg);
+		}
+	}
+}
+
+static void put_hexdump(struct log_msg *msg)
+{
+	u8_t data[64];
+	size_t len = sizeof(data);
+
+	msg_header(msg, FRAME_HEXDUMP);
+	log_msg_hexdump_data_get(msg, data, &len, 0);
+	put_bytes(data, len);
+}
+
+/* printk() text, sent as is */
+static void put_raw_string(struct log_msg *msg)
+{
+	u8_t data[64];
+	size_t offset = 0, len, i;
+
+	do {
+		len = sizeof(data);
+		log_msg_hexdump_data_get(msg, data, &len, offset);
+		for (i = 0; i < len; i++) {
+			uart_poll_out(uart_dev, data[i]);
+		}
+		offset += len;
+	} while (len);
+}
+
+static void put(const struct log_backend *const backend,
+		struct log_msg *msg)
+{
+	log_msg_get(msg);
+
+	if (log_msg_is_std(msg)) {
+		put_std(msg);
+		frame_send();
+	} else if (log_msg_level_get(msg) == LOG_LEVEL_INTERNAL_RAW_STRING) {
+		put_raw_string(msg);
+	} else {
+		put_hexdump(msg);
+		frame_send();
+	}
+
+	log_msg_put(msg);
+}
+
+static void dropped(const struct log_backend *const backend, u32_t cnt)
+{
+	frame_start(FRAME_DROPPED);
+	put_u32(cnt);
+	frame_send();
+}
+
+static void panic(const struct log_backend *const backend)
+{
+	/* Frames are always sent synchronously */
+}
+
+static void init(void)
+{
+	u32_t freq = sys_clock_hw_cycles_per_sec();
+
+	uart_dev = device_get_binding(CONFIG_FOTA_LOG_BACKEND_BINARY_DEV);
+	__ASSERT(uart_dev, "No UART for binary logs");
+
+	/* The log core's choice of timestamp source */
+	if (freq > 1000000) {
+		freq = 1000;
+	}
+
+	frame_start(FRAME_CLOCK);
+	put_u32(freq);
+	frame_send();
+}
+
+static const struct log_backend_api log_backend_bin_api = {
+	.put = put,
+	.dropped = dropped,
+	.panic = panic,
+	.init = init,
+};
+
+LOG_BACKEND_DEFINE(log_backend_fota_bin, log_backend_bin_api, true);
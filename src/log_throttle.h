@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_LOG_THROTTLE_H__
+#define FOTA_LOG_THROTTLE_H__
+
+/**
+ * @file
+ * @brief Rate-limited logging for repetitive events
+ *
+ * LOG_INF_THROTTLED() and friends log like LOG_INF(), but a given call
+ * site logs at most once per CONFIG_FOTA_LOG_THROTTLE_MS. The next
+ * message which gets through is preceded by the number of messages
+ * which were dropped since the last one.
+ *
+ * Include after <logging/log.h>, in a module which defines LOG_LEVEL.
+ */
+
+#include <zephyr.h>
+
+struct log_throttle {
+	s64_t next;
+	u32_t suppressed;
+};
+
+/*
+ * Whether a throttled message may go now. If so, *suppressed is the
+ * number of messages dropped since the last one.
+ */
+static inline bool log_throttle_pass(struct log_throttle *throttle,
+				     u32_t interval_ms, u32_t *suppressed)
+{
+	s64_t now = k_uptime_get();
+
+	if (now < throttle->next) {
+		throttle->suppressed++;
+		return false;
+	}
+
+	throttle->next = now + interval_ms;
+	*suppressed = throttle->suppressed;
+	throttle->suppressed = 0;
+
+	return true;
+}
+
+#define LOG_THROTTLED(_log, _level, ...)				\
+	do {								\
+		static struct log_throttle _throttle;			\
+		u32_t _suppressed;					\
+									\
+		if (LOG_LEVEL < (_level)) {				\
+			break;						\
+		}							\
+		if (!log_throttle_pass(&_throttle,			\
+				       CONFIG_FOTA_LOG_THROTTLE_MS,	\
+				       &_suppressed)) {			\
+			break;						\
+		}							\
+		if (_suppressed) {					\
+			_log("(%u similar messages dropped)",		\
+			     _suppressed);				\
+		}							\
+		_log(__VA_ARGS__);					\
+	} while (false)
+
+#define LOG_ERR_THROTTLED(...) LOG_THROTTLED(LOG_ERR, LOG_LEVEL_ERR, __VA_ARGS__)
+#define LOG_WRN_THROTTLED(...) LOG_THROTTLED(LOG_WRN, LOG_LEVEL_WRN, __VA_ARGS__)
+#define LOG_INF_THROTTLED(...) LOG_THROTTLED(LOG_INF, LOG_LEVEL_INF, __VA_ARGS__)
+#define LOG_DBG_THROTTLED(...) LOG_THROTTLED(LOG_DBG, LOG_LEVEL_DBG, __VA_ARGS__)
+
+#endif	/* FOTA_LOG_THROTTLE_H__ */
@@ -13,7 +13,6 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 
 #include <zephyr.h>
 #include <dfu/mcuboot.h>
-#include <dfu/flash_img.h>
 #include <flash.h>
 #include <logging/log_ctrl.h>
 #include <misc/reboot.h>
@@ -35,6 +34,22 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 #include "bluetooth.h"
 #endif
 #include "settings.h"
+#include "queue_mode.h"
+#include "reconnect.h"
+#include "server_addr.h"
+#include "server_failover.h"
+#include "fota_governor.h"
+#include "fota_timing.h"
+#include "fota_write.h"
+#if defined(CONFIG_FOTA_GROUP)
+#include "group_fota.h"
+#endif
+#if defined(CONFIG_FOTA_PEER_SERVER)
+#include "peer_server.h"
+#endif
+#if defined(CONFIG_FOTA_NET_STATS)
+#include "net_stats.h"
+#endif
 
 /* Network configuration checks */
 #if defined(CONFIG_NET_IPV6)
@@ -79,7 +94,6 @@ static u8_t client_psk_bin[LWM2M_DEVICE_TOKEN_HEX_SIZE];
 #endif /* CONFIG_LWM2M_DTLS_SUPPORT */
 
 #define FLASH_BANK0_ID DT_FLASH_AREA_IMAGE_0_ID
-#define FLASH_BANK1_ID DT_FLASH_AREA_IMAGE_1_ID
 #define FLASH_BANK_SIZE DT_FLASH_AREA_IMAGE_1_SIZE
 
 struct update_lwm2m_data {
@@ -97,23 +111,39 @@ static bool tc_logging;
 static char ep_name[LWM2M_DEVICE_ID_SIZE];
 
 static struct device *flash_dev;
-static struct flash_img_context dfu_ctx;
 static struct lwm2m_ctx client;
 
-/* storage location for firmware package */
-static u8_t firmware_buf[CONFIG_LWM2M_COAP_BLOCK_SIZE];
 /* storage location for firmware version */
 static char firmware_version[32];
 
 static struct k_delayed_work reboot_work;
+
+/*
+ * Background cleanup of bank 1 after an update. The lock keeps it
+ * from racing with a firmware download, which takes over bank 1.
+ */
+static struct k_delayed_work slot1_cleanup_work;
+static K_MUTEX_DEFINE(slot1_lock);
+static bool slot1_cleanup_pending;
+static off_t slot1_cleanup_offset;
 static struct net_mgmt_event_callback cb;
 static struct k_work net_event_work;
+static struct k_work net_resume_work;
+static atomic_t lwm2m_started;
 static struct k_work_q *net_event_work_q;
 
-static void *firmware_read_cb(u16_t obj_inst_id, size_t *data_len)
-{
-	*data_len = strlen(firmware_version);
+/*
+ * RD client restarts. While registered, a restart deregisters first
+ * and only starts again from the DISCONNECT event which follows.
+ */
+static struct k_work rd_restart_work;
+static atomic_t rd_registered;
+/* stopped by a failure, until the reconnect manager restarts it */
+static atomic_t rd_backoff;
+static atomic_t rd_restart_pending;
 
+const char *lwm2m_firmware_version_get(void)
+{
 	return firmware_version;
 }
 
@@ -135,6 +165,18 @@ static int device_reboot_cb(u16_t obj_inst_id)
 	return 0;
 }
 
+/* Stop the bank 1 cleanup: the caller is about to reuse the bank. */
+void lwm2m_slot1_cleanup_cancel(void)
+{
+	k_mutex_lock(&slot1_lock, K_FOREVER);
+	if (slot1_cleanup_pending) {
+		LOG_DBG("Bank 1 cleanup superseded");
+		slot1_cleanup_pending = false;
+		k_delayed_work_cancel(&slot1_cleanup_work);
+	}
+	k_mutex_unlock(&slot1_lock);
+}
+
 #ifdef CONFIG_LWM2M_FIRMWARE_UPDATE_OBJ_SUPPORT
 static int firmware_update_cb(u16_t obj_inst_id)
 {
@@ -167,115 +209,6 @@ static int firmware_update_cb(u16_t obj_inst_id)
 cleanup:
 	return ret;
 }
-
-static void *firmware_get_buf(u16_t obj_inst_id, size_t *data_len)
-{
-	*data_len = sizeof(firmware_buf);
-	return firmware_buf;
-}
-
-static int firmware_block_received_cb(u16_t obj_inst_id,
-				      u8_t *data, u16_t data_len,
-				      bool last_block, size_t total_size)
-{
-#if defined(CONFIG_FOTA_ERASE_PROGRESSIVELY)
-	static int last_offset = DT_FLASH_AREA_IMAGE_1_OFFSET;
-#endif
-	static u8_t percent_downloaded;
-	static u32_t bytes_downloaded;
-	u8_t downloaded;
-	int ret = 0;
-
-	if (total_size > FLASH_BANK_SIZE) {
-		LOG_ERR("Artifact file size too big (%d)", total_size);
-		return -EINVAL;
-	}
-
-	if (!data_len) {
-		LOG_ERR("Data len is zero, nothing to write.");
-		return -EINVAL;
-	}
-
-	/* Erase bank 1 before starting the write process */
-	if (bytes_downloaded == 0) {
-		flash_img_init(&dfu_ctx);
-#if defined(CONFIG_FOTA_ERASE_PROGRESSIVELY)
-		LOG_INF("Download firmware started, erasing progressively.");
-		/* reset image data */
-		ret = boot_invalidate_slot1();
-		if (ret != 0) {
-			LOG_ERR("Failed to reset image data in bank 1");
-			goto cleanup;
-		}
-#else
-		LOG_INF("Download firmware started, erasing second bank");
-		ret = boot_erase_img_bank(FLASH_BANK1_ID);
-		if (ret != 0) {
-			LOG_ERR("Failed to erase flash bank 1");
-			goto cleanup;
-		}
-#endif
-	}
-
-	bytes_downloaded += data_len;
-
-	/* display a % downloaded, if it's different */
-	if (total_size) {
-		downloaded = bytes_downloaded * 100 / total_size;
-	} else {
-		/* Total size is empty when there is only one block */
-		downloaded = 100;
-	}
-
-	if (downloaded > percent_downloaded) {
-		percent_downloaded = downloaded;
-		LOG_INF("%d%%", percent_downloaded);
-	}
-
-#if defined(CONFIG_FOTA_ERASE_PROGRESSIVELY)
-	/* Erase the sector that's going to be written to next */
-	while (last_offset <
-	       DT_FLASH_AREA_IMAGE_1_OFFSET + dfu_ctx.bytes_written +
-	       DT_FLASH_ERASE_BLOCK_SIZE) {
-		LOG_INF("Erasing sector at offset 0x%x", last_offset);
-		flash_write_protection_set(flash_dev, false);
-		ret = flash_erase(flash_dev, last_offset,
-				  DT_FLASH_ERASE_BLOCK_SIZE);
-		flash_write_protection_set(flash_dev, true);
-		last_offset += DT_FLASH_ERASE_BLOCK_SIZE;
-		if (ret) {
-			LOG_ERR("Error %d while erasing sector", ret);
-			goto cleanup;
-		}
-	}
-#endif
-
-	ret = flash_img_buffered_write(&dfu_ctx, data, data_len, last_block);
-	if (ret < 0) {
-		LOG_ERR("Failed to write flash block");
-		goto cleanup;
-	}
-
-	if (!last_block) {
-		/* Keep going */
-		return ret;
-	}
-
-	if (total_size && (bytes_downloaded != total_size)) {
-		LOG_ERR("Early last block, downloaded %d, expecting %d",
-			bytes_downloaded, total_size);
-		ret = -EIO;
-	}
-
-cleanup:
-#if defined(CONFIG_FOTA_ERASE_PROGRESSIVELY)
-	last_offset = DT_FLASH_AREA_IMAGE_1_OFFSET;
-#endif
-	bytes_downloaded = 0;
-	percent_downloaded = 0;
-
-	return ret;
-}
 #endif
 
 #if defined(CONFIG_LWM2M_DTLS_SUPPORT)
@@ -312,15 +245,50 @@ static int generate_hex(char *src, u8_t *dst, size_t dst_len)
 }
 #endif /* CONFIG_LWM2M_DTLS_SUPPORT */
 
-static int lwm2m_setup(void)
+/*
+ * Point the security object at the current server: the secondary
+ * after a failover, otherwise the primary, by cached address if any.
+ * The 1.14 RD client only registers with the first non-bootstrap
+ * security instance, so a failover rewrites its URI rather than
+ * switching to a second instance.
+ */
+static int server_url_set(void)
 {
-	const struct product_id_t *product_id = product_id_get();
-	static char device_serial_no[10];
+	char cached[INET6_ADDRSTRLEN];
+	const char *addr;
 	char *server_url;
 	u16_t server_url_len;
 	u8_t server_url_flags;
 	int ret;
 
+	if (server_failover_current() == SERVER_SECONDARY) {
+		addr = server_failover_secondary_addr();
+	} else {
+		addr = server_addr_get(cached, sizeof(cached)) ?
+		       cached : SERVER_ADDR;
+	}
+
+	ret = lwm2m_engine_get_res_data("0/0/0",
+					(void **)&server_url, &server_url_len,
+					&server_url_flags);
+	if (ret < 0) {
+		return ret;
+	}
+
+	snprintk(server_url, server_url_len, "coap%s//%s%s%s",
+		 IS_ENABLED(CONFIG_LWM2M_DTLS_SUPPORT) ? "s:" : ":",
+		 strchr(addr, ':') ? "[" : "", addr,
+		 strchr(addr, ':') ? "]" : "");
+
+	return 0;
+}
+
+static int lwm2m_setup(void)
+{
+	const struct product_id_t *product_id = product_id_get();
+	static char device_serial_no[10];
+	int ret;
+
 	snprintk(device_serial_no, sizeof(device_serial_no), "%08x",
 		 product_id->number);
 	/* Check if there is a valid device id stored in the device */
@@ -372,18 +340,12 @@ static int lwm2m_setup(void)
 #endif /* CONFIG_LWM2M_DTLS_SUPPORT */
 
 	/* Server URL */
-	ret = lwm2m_engine_get_res_data("0/0/0",
-					(void **)&server_url, &server_url_len,
-					&server_url_flags);
+	server_addr_init(SERVER_ADDR);
+	ret = server_url_set();
 	if (ret < 0) {
 		return ret;
 	}
 
-	snprintk(server_url, server_url_len, "coap%s//%s%s%s",
-		 IS_ENABLED(CONFIG_LWM2M_DTLS_SUPPORT) ? "s:" : ":",
-		 strchr(SERVER_ADDR, ':') ? "[" : "", SERVER_ADDR,
-		 strchr(SERVER_ADDR, ':') ? "]" : "");
-
 	/* Security Mode */
 	lwm2m_engine_set_u8("0/0/2",
 			    IS_ENABLED(CONFIG_LWM2M_DTLS_SUPPORT) ? 0 : 3);
@@ -393,7 +355,45 @@ static int lwm2m_setup(void)
 				(void *)client_psk_bin, sizeof(client_psk_bin));
 #endif /* CONFIG_LWM2M_DTLS_SUPPORT */
 
-	/* Device Object values and callbacks */
+	ret = queue_mode_init();
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = fota_governor_init(&client);
+	if (ret < 0) {
+		return ret;
+	}
+
+#if defined(CONFIG_FOTA_NET_STATS)
+	ret = net_stats_init();
+	if (ret < 0) {
+		return ret;
+	}
+#endif
+
+#if defined(CONFIG_FOTA_GROUP)
+	/* Not fatal: regular downloads still work without the group */
+	ret = group_fota_init();
+	if (ret < 0) {
+		LOG_ERR("Group firmware transfers unavailable: %d", ret);
+	}
+#endif
+
+#if defined(CONFIG_FOTA_PEER_SERVER)
+	/* lwm2m_image_init() has confirmed the running image by now */
+	ret = peer_server_init();
+	if (ret < 0) {
+		LOG_ERR("Cannot serve the firmware image to peers: %d", ret);
+	}
+#endif
+
+	/*
+	 * Device Object values and callbacks. The constant ones are
+	 * plain read-only data. They are still encoded again on every
+	 * read of /3/0: caching the encoded object would take a hook in
+	 * the 1.14 engine's read path, which it doesn't have.
+	 */
 	lwm2m_engine_set_res_data("3/0/0", CLIENT_MANUFACTURER,
 				  sizeof(CLIENT_MANUFACTURER),
 				  LWM2M_RES_DATA_FLAG_RO);
@@ -403,7 +403,14 @@ static int lwm2m_setup(void)
 	lwm2m_engine_set_res_data("3/0/2", device_serial_no,
 				  sizeof(device_serial_no),
 				  LWM2M_RES_DATA_FLAG_RO);
-	lwm2m_engine_register_read_callback("3/0/3", firmware_read_cb);
+	/*
+	 * Set once by log_img_ver(), at image init. This only saves the
+	 * read callback: the 1.14 engine still strlen()s string data on
+	 * every read.
+	 */
+	lwm2m_engine_set_res_data("3/0/3", firmware_version,
+				  sizeof(firmware_version),
+				  LWM2M_RES_DATA_FLAG_RO);
 	lwm2m_engine_register_exec_callback("3/0/4", device_reboot_cb);
 	lwm2m_engine_set_res_data("3/0/17", CLIENT_DEVICE_TYPE,
 				  sizeof(CLIENT_DEVICE_TYPE),
@@ -418,9 +425,10 @@ static int lwm2m_setup(void)
 
 #ifdef CONFIG_LWM2M_FIRMWARE_UPDATE_OBJ_SUPPORT
 	/* Firmware Object callbacks */
+	fota_write_init(flash_dev);
 	/* setup data buffer for block-wise transfer */
-	lwm2m_engine_register_pre_write_callback("5/0/0", firmware_get_buf);
-	lwm2m_firmware_set_write_cb(firmware_block_received_cb);
+	lwm2m_engine_register_pre_write_callback("5/0/0", fota_write_get_buf);
+	lwm2m_firmware_set_write_cb(fota_write_block);
 	lwm2m_firmware_set_update_cb(firmware_update_cb);
 #endif
 
@@ -443,6 +451,43 @@ static void handle_test_result(struct update_lwm2m_data *data, u8_t result)
 	}
 }
 
+/* A connection failed: blame a stale cached address first. */
+static void server_failure(void)
+{
+	if (server_failover_current() == SERVER_PRIMARY &&
+	    server_addr_fallback()) {
+		return;
+	}
+
+	server_failover_failure();
+}
+
+static void rd_client_event(struct lwm2m_ctx *client,
+			    enum lwm2m_rd_client_event client_event);
+
+/*
+ * Hold the RD client back after a failure: left running, it would
+ * register again right away. The reconnect manager restarts it.
+ */
+static void rd_client_backoff(struct lwm2m_ctx *ctx)
+{
+	atomic_set(&rd_backoff, 1);
+	lwm2m_rd_client_stop(ctx, rd_client_event);
+	reconnect_schedule();
+}
+
+/* The RD client stopped: restart it if that is what we asked for. */
+static bool rd_client_stopped(void)
+{
+	atomic_clear(&rd_registered);
+	if (!atomic_cas(&rd_restart_pending, 1, 0)) {
+		return false;
+	}
+
+	app_wq_submit(&rd_restart_work);
+	return true;
+}
+
 static void rd_client_event(struct lwm2m_ctx *client,
 			    enum lwm2m_rd_client_event client_event)
 {
@@ -458,6 +503,7 @@ static void rd_client_event(struct lwm2m_ctx *client,
 			TC_END_REPORT(TC_FAIL);
 			tc_logging = false;
 		}
+		rd_client_backoff(client);
 		break;
 
 	case LWM2M_RD_CLIENT_EVENT_BOOTSTRAP_REG_COMPLETE:
@@ -474,9 +520,21 @@ static void rd_client_event(struct lwm2m_ctx *client,
 			TC_END_REPORT(TC_FAIL);
 			tc_logging = false;
 		}
+		atomic_clear(&rd_registered);
+		/* the DISCONNECT event which comes with it counts the failure */
+		rd_client_backoff(client);
 		break;
 
 	case LWM2M_RD_CLIENT_EVENT_REGISTRATION_COMPLETE:
+		atomic_set(&rd_registered, 1);
+		reconnect_reset();
+		server_failover_registered();
+		server_addr_registered();
+		fota_timing_registered();
+		queue_mode_uplink();
+		if (slot1_cleanup_pending) {
+			app_wq_submit(&slot1_cleanup_work.work);
+		}
 		if (tc_logging) {
 			Z_TC_END_RESULT(TC_PASS, "lwm2m_registration");
 		}
@@ -487,22 +545,102 @@ static void rd_client_event(struct lwm2m_ctx *client,
 		break;
 
 	case LWM2M_RD_CLIENT_EVENT_REG_UPDATE_COMPLETE:
+		queue_mode_uplink();
 		handle_test_result(&update_data, TC_PASS);
 		break;
 
 	case LWM2M_RD_CLIENT_EVENT_DEREGISTER_FAILURE:
 		LOG_DBG("Deregister failure!");
-		/* TODO: handle deregister? */
+		if (!rd_client_stopped()) {
+			rd_client_backoff(client);
+		}
 		break;
 
 	case LWM2M_RD_CLIENT_EVENT_DISCONNECT:
 		LOG_DBG("Disconnected");
-		/* TODO: handle disconnect? */
+		if (!rd_client_stopped()) {
+			server_failure();
+			rd_client_backoff(client);
+		}
 		break;
 
 	}
 }
 
+static void rd_client_start(void)
+{
+	/* pick up a failover, a refreshed address or a fallback */
+	server_url_set();
+	server_failover_connecting();
+	atomic_clear(&rd_backoff);
+	lwm2m_rd_client_start(&client, ep_name, rd_client_event);
+}
+
+/*
+ * Restart the RD client state machine from scratch. Starting right
+ * after stopping would overwrite the deregistration a stop begins
+ * while registered, so in that case wait for it to finish.
+ */
+static void rd_client_restart(struct k_work *work)
+{
+	if (atomic_get(&rd_registered)) {
+		atomic_set(&rd_restart_pending, 1);
+		lwm2m_rd_client_stop(&client, rd_client_event);
+		return;
+	}
+
+	lwm2m_rd_client_stop(&client, rd_client_event);
+	rd_client_start();
+}
+
+/*
+ * Clean up bank 1 after an update, one step per run so other work
+ * can get in between. Without progressive erase, sectors are erased
+ * from the top of the bank down: the image trailer goes first, so
+ * the old image is invalid from the first step on.
+ */
+static void slot1_cleanup(struct k_work *work)
+{
+	int ret;
+
+	k_mutex_lock(&slot1_lock, K_FOREVER);
+	if (!slot1_cleanup_pending) {
+		goto out;
+	}
+
+#if defined(CONFIG_FOTA_ERASE_PROGRESSIVELY)
+	/* instead of erasing slot 1, reset image data */
+	ret = boot_invalidate_slot1();
+	if (ret) {
+		LOG_ERR("Flash image 1 reset: error %d", ret);
+	} else {
+		LOG_DBG("Reset image data in bank 1");
+	}
+	slot1_cleanup_pending = false;
+#else
+	slot1_cleanup_offset -= DT_FLASH_ERASE_BLOCK_SIZE;
+	flash_write_protection_set(flash_dev, false);
+	ret = flash_erase(flash_dev, slot1_cleanup_offset,
+			  DT_FLASH_ERASE_BLOCK_SIZE);
+	flash_write_protection_set(flash_dev, true);
+	if (ret) {
+		LOG_ERR("Flash bank erase at offset %x: error %d",
+			(u32_t)slot1_cleanup_offset, ret);
+		slot1_cleanup_pending = false;
+	} else if (slot1_cleanup_offset == DT_FLASH_AREA_IMAGE_1_OFFSET) {
+		LOG_DBG("Erased flash bank 1 at offset %x",
+			DT_FLASH_AREA_IMAGE_1_OFFSET);
+		slot1_cleanup_pending = false;
+	} else {
+		app_wq_submit_delayed(&slot1_cleanup_work,
+				      CONFIG_FOTA_SLOT1_CLEANUP_INTERVAL_MS);
+	}
+#endif
+
+out:
+	k_mutex_unlock(&slot1_lock);
+}
+
 /* Log the semantic version number of the current image. */
 static void log_img_ver(void)
 {
@@ -533,6 +671,8 @@ static int lwm2m_image_init(void)
 	struct update_counter counter;
 	bool image_ok;
 
+	k_delayed_work_init(&slot1_cleanup_work, slot1_cleanup);
+
 	/*
 	 * Initialize the DFU context.
 	 */
@@ -561,27 +701,11 @@ static int lwm2m_image_init(void)
 			return ret;
 		}
 		LOG_INF("Marked image as OK");
-#if defined(CONFIG_FOTA_ERASE_PROGRESSIVELY)
-		/* instead of erasing slot 1, reset image data */
-		ret = boot_invalidate_slot1();
-		if (ret) {
-			LOG_ERR("Flash image 1 reset: error %d", ret);
-			return ret;
-		}
 
-		LOG_DBG("Erased flash bank 1 at offset %x",
-			DT_FLASH_AREA_IMAGE_1_OFFSET);
-#else
-		ret = boot_erase_img_bank(FLASH_BANK1_ID);
-		if (ret) {
-			LOG_ERR("Flash bank erase at offset %x: error %d",
-				DT_FLASH_AREA_IMAGE_1_OFFSET, ret);
-			return ret;
-		}
-
-		LOG_DBG("Erased flash bank 1 at offset %x",
-			DT_FLASH_AREA_IMAGE_1_OFFSET);
-#endif
+		/* Bank 1 is cleaned up once we are registered */
+		slot1_cleanup_offset = DT_FLASH_AREA_IMAGE_1_OFFSET +
+			FLASH_BANK_SIZE;
+		slot1_cleanup_pending = true;
 
 		if (counter.update != -1) {
 			ret = fota_update_counter_update(COUNTER_CURRENT,
@@ -689,19 +813,49 @@ static void lwm2m_start(struct k_work *work)
 	client.tls_tag = TLS_TAG;
 #endif /* CONFIG_LWM2M_DTLS_SUPPORT */
 
+	k_work_init(&rd_restart_work, rd_client_restart);
+	reconnect_init(rd_client_restart);
+	server_failover_init(rd_client_restart);
+
 	/* small delay to finalize networking */
 	k_sleep(K_SECONDS(2));
 	TC_PRINT("LwM2M registration\n");
 
 	/* client.sec_obj_inst is 0 as a starting point */
+	server_failover_connecting();
 	lwm2m_rd_client_start(&client, ep_name, rd_client_event);
 	LOG_INF("setup complete.");
 }
 
+/*
+ * The link came back after an outage (e.g. a Bluetooth reconnect).
+ * Failures during the outage say nothing about the server: drop the
+ * backoff. If the RD client still has its registration, just update
+ * it; if a failure stopped it, restart it now rather than when the
+ * backoff expires.
+ */
+static void lwm2m_resume(struct k_work *work)
+{
+	reconnect_reset();
+
+	if (atomic_get(&rd_backoff)) {
+		LOG_INF("Network is back, registering again");
+		app_wq_submit(&rd_restart_work);
+	} else {
+		LOG_INF("Network is back, updating registration");
+		lwm2m_rd_client_update();
+	}
+}
+
 static void event_iface_up(struct net_mgmt_event_callback *cb,
 		u32_t mgmt_event, struct net_if *iface)
 {
-	k_work_submit_to_queue(net_event_work_q, &net_event_work);
+	/* the callback and lwm2m_init() may both see the first IF_UP */
+	if (atomic_cas(&lwm2m_started, 0, 1)) {
+		k_work_submit_to_queue(net_event_work_q, &net_event_work);
+	} else {
+		k_work_submit_to_queue(net_event_work_q, &net_resume_work);
+	}
 }
 
 int lwm2m_init(struct k_work_q *work_q)
@@ -709,6 +863,7 @@ int lwm2m_init(struct k_work_q *work_q)
 	struct net_if *iface;
 
 	k_work_init(&net_event_work, lwm2m_start);
+	k_work_init(&net_resume_work, lwm2m_resume);
 	net_event_work_q = work_q;
 
 	iface = net_if_get_default();
@@ -719,12 +874,13 @@ int lwm2m_init(struct k_work_q *work_q)
 		return -ENETDOWN;
 	}
 
-	/* Subscribe to NET_EVENT_IF_UP if interface is not ready */
-	if (!net_if_is_up(iface)) {
-		net_mgmt_init_event_callback(&cb, event_iface_up,
-				NET_EVENT_IF_UP);
-		net_mgmt_add_event_callback(&cb);
-	} else {
+	/*
+	 * Subscribe to NET_EVENT_IF_UP: it starts LwM2M if the interface
+	 * is not ready yet, and resumes the session after an outage.
+	 */
+	net_mgmt_init_event_callback(&cb, event_iface_up, NET_EVENT_IF_UP);
+	net_mgmt_add_event_callback(&cb);
+	if (net_if_is_up(iface)) {
 		event_iface_up(NULL, NET_EVENT_IF_UP, iface);
 	}
 
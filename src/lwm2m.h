@@ -9,4 +9,13 @@
 
 int lwm2m_init(struct k_work_q *work_q);
 
+/*
+ * Stop any background cleanup of image bank 1 after an update;
+ * call this before writing a new image into the bank.
+ */
+void lwm2m_slot1_cleanup_cancel(void);
+
+/* Version string of the running image, e.g. "1.2.0 build #3" */
+const char *lwm2m_firmware_version_get(void);
+
 #endif	/* FOTA_LWM2M_H__ */
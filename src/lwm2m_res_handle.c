@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_res_handle
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <string.h>
+#include <net/lwm2m.h>
+
+#include "lwm2m_object.h"
+#include "lwm2m_engine.h"
+
+#include "lwm2m_res_handle.h"
+#include "queue_mode.h"
+
+int lwm2m_res_handle_init(struct lwm2m_res_handle *handle,
+			  struct lwm2m_engine_obj_inst *obj_inst,
+			  u16_t res_id)
+{
+	int i;
+
+	for (i = 0; i < obj_inst->resource_count; i++) {
+		if (obj_inst->resources[i].res_id == res_id) {
+			handle->obj_inst = obj_inst;
+			handle->res = &obj_inst->resources[i];
+			return 0;
+		}
+	}
+
+	LOG_ERR("No resource %u/%u/%u", obj_inst->obj->obj_id,
+		obj_inst->obj_inst_id, res_id);
+
+	return -ENOENT;
+}
+
+int lwm2m_res_handle_set(const struct lwm2m_res_handle *handle,
+			 const void *value, u16_t len)
+{
+	struct lwm2m_engine_res_inst *res = handle->res;
+	bool changed;
+
+	if (!res->data_ptr || len != res->data_len) {
+		return -EINVAL;
+	}
+
+	changed = memcmp(res->data_ptr, value, len) != 0;
+	memcpy(res->data_ptr, value, len);
+
+	if (res->post_write_cb) {
+		res->post_write_cb(handle->obj_inst->obj_inst_id,
+				   res->data_ptr, len, false, 0);
+	}
+
+	if (changed) {
+		queue_mode_notify(handle->obj_inst->obj->obj_id,
+				  handle->obj_inst->obj_inst_id,
+				  res->res_id);
+	}
+
+	return 0;
+}
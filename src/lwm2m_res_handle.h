@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_LWM2M_RES_HANDLE_H__
+#define FOTA_LWM2M_RES_HANDLE_H__
+
+/**
+ * @file
+ * @brief Pre-resolved LwM2M resource handles
+ *
+ * The lwm2m_engine_set_*() helpers parse a path string and walk the
+ * object instance list on every call. A handle points straight at the
+ * resource instance, looked up once in the object instance the
+ * application created. Setting through it does what the engine does
+ * for a path: copy the value, run the resource's post-write hook and
+ * notify observers if the value changed (held back while asleep in
+ * Queue Mode, see queue_mode.h).
+ *
+ * A handle stays valid as long as its object instance exists; the
+ * resource's storage may be changed with lwm2m_engine_set_res_data().
+ */
+
+#include <zephyr/types.h>
+
+struct lwm2m_engine_obj_inst;
+struct lwm2m_engine_res_inst;
+
+struct lwm2m_res_handle {
+	struct lwm2m_engine_obj_inst *obj_inst;
+	struct lwm2m_engine_res_inst *res;
+};
+
+/**
+ * @brief Resolve a resource of an object instance.
+ *
+ * @param obj_inst Instance, as returned by lwm2m_create_obj_inst().
+ * @return 0 on success, -ENOENT if the instance has no such resource.
+ */
+int lwm2m_res_handle_init(struct lwm2m_res_handle *handle,
+			  struct lwm2m_engine_obj_inst *obj_inst,
+			  u16_t res_id);
+
+/**
+ * @brief Set the resource value.
+ *
+ * The post-write hook always runs; observers are only notified if the
+ * value changed.
+ *
+ * @return 0 on success, -EINVAL if len doesn't match the resource.
+ */
+int lwm2m_res_handle_set(const struct lwm2m_res_handle *handle,
+			 const void *value, u16_t len);
+
+#endif	/* FOTA_LWM2M_RES_HANDLE_H__ */
@@ -23,14 +23,21 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 #include "product_id.h"
 #include "lwm2m.h"
 #include "light_control.h"
+#include "lwm2m_object.h"
+#include "lwm2m_engine.h"
+#include "lwm2m_res_handle.h"
 #include "settings.h"
 
 /* Defines and configs for the IPSO elements */
 #define TEMP_DEV		"fota-temp"
 #define TEMP_CHAN		SENSOR_CHAN_DIE_TEMP
 
+#define IPSO_OBJECT_TEMP_SENSOR_ID	3303
+#define SENSOR_VALUE_ID			5700
+
 static struct device *die_dev;
 static struct float32_value temp_float;
+static struct lwm2m_res_handle temp_value;
 
 static int read_temperature(struct device *temp_dev,
 			    struct float32_value *float_val)
@@ -67,13 +74,16 @@ static void *temp_read_cb(u16_t obj_inst_id, size_t *data_len)
 	}
 
 	/*
-	 * No need to check if read was successful, just reuse the
-	 * previous value which is already stored at temp_float.
-	 * This is because there is currently no way to report read_cb
-	 * failures to the LWM2M engine.
+	 * If the read fails, just reuse the previous value which is
+	 * still stored at temp_float. This is because there is
+	 * currently no way to report read_cb failures to the LWM2M
+	 * engine.
 	 */
-	read_temperature(die_dev, &temp_float);
-	lwm2m_engine_set_float32("3303/0/5700", &temp_float);
+	if (!read_temperature(die_dev, &temp_float)) {
+		/* The IPSO object's post-write hook keeps min/max */
+		lwm2m_res_handle_set(&temp_value, &temp_float,
+				     sizeof(temp_float));
+	}
 	*data_len = sizeof(temp_float);
 
 	return &temp_float;
@@ -93,6 +103,19 @@ static int init_temp_device(void)
 	return 0;
 }
 
+static int init_temp_object(void)
+{
+	struct lwm2m_engine_obj_inst *obj_inst;
+	int ret;
+
+	ret = lwm2m_create_obj_inst(IPSO_OBJECT_TEMP_SENSOR_ID, 0, &obj_inst);
+	if (ret < 0) {
+		return ret;
+	}
+
+	return lwm2m_res_handle_init(&temp_value, obj_inst, SENSOR_VALUE_ID);
+}
+
 void main(void)
 {
 	app_wq_init();
@@ -107,7 +130,11 @@ void main(void)
 		TC_END_REPORT(TC_FAIL);
 		return;
 	}
-	lwm2m_engine_create_obj_inst("3303/0");
+	if (init_temp_object()) {
+		Z_TC_END_RESULT(TC_FAIL, "init_temp_device");
+		TC_END_REPORT(TC_FAIL);
+		return;
+	}
 	lwm2m_engine_register_read_callback("3303/0/5700", temp_read_cb);
 	lwm2m_engine_set_string("3303/0/5701", "Cel");
 	Z_TC_END_RESULT(TC_PASS, "init_temp_device");
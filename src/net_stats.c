@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_net_stats
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <init.h>
+#include <stdio.h>
+#include <net/net_pkt.h>
+#include <net/lwm2m.h>
+
+#include "lwm2m_object.h"
+#include "lwm2m_engine.h"
+
+#include "app_work_queue.h"
+#include "net_stats.h"
+
+#define NET_STATS_OBJECT_ID		26241
+
+#define NET_STATS_SIZE_ID		0
+#define NET_STATS_USED_ID		1
+#define NET_STATS_MAX_USED_ID		2
+#define NET_STATS_EXHAUSTED_ID		3
+#define NET_STATS_EXHAUSTED_MS_ID	4
+#define NET_STATS_SAMPLING_ID		5
+
+#define NET_STATS_MAX_ID		6
+
+static const char * const pool_names[NET_STATS_POOL_COUNT] = {
+	[NET_STATS_PKT_RX] = "RX packets",
+	[NET_STATS_PKT_TX] = "TX packets",
+	[NET_STATS_BUF_RX] = "RX data buffers",
+	[NET_STATS_BUF_TX] = "TX data buffers",
+};
+
+static struct net_stats_pool_data pools[NET_STATS_POOL_COUNT];
+/* uptime at which each pool last ran dry, or 0 if it has buffers */
+static s64_t empty_since[NET_STATS_POOL_COUNT];
+
+static struct k_delayed_work sample_work;
+/* shared by all instances: sampling is on for all pools or none */
+static bool sampling;
+
+static struct lwm2m_engine_obj net_stats_obj;
+static struct lwm2m_engine_obj_field fields[] = {
+	OBJ_FIELD_DATA(NET_STATS_SIZE_ID, R, U32),
+	OBJ_FIELD_DATA(NET_STATS_USED_ID, R, U32),
+	OBJ_FIELD_DATA(NET_STATS_MAX_USED_ID, R, U32),
+	OBJ_FIELD_DATA(NET_STATS_EXHAUSTED_ID, R, U32),
+	OBJ_FIELD_DATA(NET_STATS_EXHAUSTED_MS_ID, R, U32),
+	OBJ_FIELD_DATA(NET_STATS_SAMPLING_ID, RW, BOOL),
+};
+
+static struct lwm2m_engine_obj_inst inst[NET_STATS_POOL_COUNT];
+static struct lwm2m_engine_res_inst res[NET_STATS_POOL_COUNT]
+				       [NET_STATS_MAX_ID];
+
+static void pool_sample(enum net_stats_pool pool, u32_t size, u32_t free)
+{
+	struct net_stats_pool_data *data = &pools[pool];
+	s64_t now = k_uptime_get();
+
+	data->size = size;
+	data->used = size - free;
+	if (data->used > data->max_used) {
+		data->max_used = data->used;
+	}
+
+	if (free == 0) {
+		if (!empty_since[pool]) {
+			data->exhausted++;
+			empty_since[pool] = now;
+		}
+	} else if (empty_since[pool]) {
+		data->exhausted_ms += (u32_t)(now - empty_since[pool]);
+		empty_since[pool] = 0;
+	}
+}
+
+static void net_stats_sample(struct k_work *work)
+{
+	struct k_mem_slab *rx, *tx;
+	struct net_buf_pool *rx_data, *tx_data;
+
+	net_pkt_get_info(&rx, &tx, &rx_data, &tx_data);
+
+	pool_sample(NET_STATS_PKT_RX, rx->num_blocks,
+		    k_mem_slab_num_free_get(rx));
+	pool_sample(NET_STATS_PKT_TX, tx->num_blocks,
+		    k_mem_slab_num_free_get(tx));
+	pool_sample(NET_STATS_BUF_RX, rx_data->buf_count,
+		    atomic_get(&rx_data->avail_count));
+	pool_sample(NET_STATS_BUF_TX, tx_data->buf_count,
+		    atomic_get(&tx_data->avail_count));
+
+	if (sampling) {
+		app_wq_submit_delayed(&sample_work,
+				      CONFIG_FOTA_NET_STATS_INTERVAL_MS);
+	}
+}
+
+void net_stats_sampling(bool on)
+{
+	sampling = on;
+	if (on) {
+		LOG_INF("Sampling network pools every %d ms",
+			CONFIG_FOTA_NET_STATS_INTERVAL_MS);
+		app_wq_submit(&sample_work.work);
+	} else {
+		k_delayed_work_cancel(&sample_work);
+	}
+}
+
+bool net_stats_is_sampling(void)
+{
+	return sampling;
+}
+
+static int sampling_write_cb(u16_t obj_inst_id, u8_t *data, u16_t data_len,
+			     bool last_block, size_t total_size)
+{
+	net_stats_sampling(*data);
+
+	return 0;
+}
+
+const struct net_stats_pool_data *net_stats_get(enum net_stats_pool pool)
+{
+	return &pools[pool];
+}
+
+const char *net_stats_pool_name(enum net_stats_pool pool)
+{
+	return pool_names[pool];
+}
+
+static struct lwm2m_engine_obj_inst *net_stats_create(u16_t obj_inst_id)
+{
+	struct net_stats_pool_data *data;
+	int i = 0;
+
+	if (obj_inst_id >= NET_STATS_POOL_COUNT) {
+		LOG_ERR("No pool for instance %u", obj_inst_id);
+		return NULL;
+	}
+
+	data = &pools[obj_inst_id];
+
+	/* the engine reads the live counters directly */
+	INIT_OBJ_RES_DATA(res[obj_inst_id], i, NET_STATS_SIZE_ID,
+			  &data->size, sizeof(data->size));
+	INIT_OBJ_RES_DATA(res[obj_inst_id], i, NET_STATS_USED_ID,
+			  &data->used, sizeof(data->used));
+	INIT_OBJ_RES_DATA(res[obj_inst_id], i, NET_STATS_MAX_USED_ID,
+			  &data->max_used, sizeof(data->max_used));
+	INIT_OBJ_RES_DATA(res[obj_inst_id], i, NET_STATS_EXHAUSTED_ID,
+			  &data->exhausted, sizeof(data->exhausted));
+	INIT_OBJ_RES_DATA(res[obj_inst_id], i, NET_STATS_EXHAUSTED_MS_ID,
+			  &data->exhausted_ms, sizeof(data->exhausted_ms));
+	INIT_OBJ_RES_DATA(res[obj_inst_id], i, NET_STATS_SAMPLING_ID,
+			  &sampling, sizeof(sampling));
+
+	inst[obj_inst_id].resources = res[obj_inst_id];
+	inst[obj_inst_id].resource_count = i;
+
+	return &inst[obj_inst_id];
+}
+
+int net_stats_init(void)
+{
+	char path[sizeof("65535/65535/65535")];
+	int i, ret;
+
+	k_delayed_work_init(&sample_work, net_stats_sample);
+
+	for (i = 0; i < NET_STATS_POOL_COUNT; i++) {
+		snprintk(path, sizeof(path), "%u/%u", NET_STATS_OBJECT_ID, i);
+		ret = lwm2m_engine_create_obj_inst(path);
+		if (ret < 0) {
+			LOG_ERR("Failed to create %s: %d", path, ret);
+			return ret;
+		}
+
+		snprintk(path, sizeof(path), "%u/%u/%u", NET_STATS_OBJECT_ID,
+			 i, NET_STATS_SAMPLING_ID);
+		ret = lwm2m_engine_register_post_write_callback(
+			path, sampling_write_cb);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int net_stats_obj_init(struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	net_stats_obj.obj_id = NET_STATS_OBJECT_ID;
+	net_stats_obj.fields = fields;
+	net_stats_obj.field_count = ARRAY_SIZE(fields);
+	net_stats_obj.max_instance_count = NET_STATS_POOL_COUNT;
+	net_stats_obj.create_cb = net_stats_create;
+	lwm2m_register_obj(&net_stats_obj);
+
+	return 0;
+}
+
+SYS_INIT(net_stats_obj_init, APPLICATION, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
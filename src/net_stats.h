@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_NET_STATS_H__
+#define FOTA_NET_STATS_H__
+
+/**
+ * @file
+ * @brief Network buffer pool statistics
+ *
+ * Samples the network packet slabs and data buffer pools and keeps
+ * track of how close they come to running out. Each pool is exposed
+ * as an instance of vendor LwM2M object 26241:
+ *
+ * - 0: pool size
+ * - 1: currently in use
+ * - 2: maximum in use (high-water mark)
+ * - 3: number of times the pool ran dry
+ * - 4: total time the pool was empty, in milliseconds
+ * - 5: sampling on (read/write, shared by all instances)
+ *
+ * Sampling is off at boot. The figures are estimates: the pools are
+ * only looked at every CONFIG_FOTA_NET_STATS_INTERVAL_MS, as Zephyr
+ * 1.14 offers no hook where buffers are allocated. Shorter bursts, the
+ * allocations which failed and the time spent waiting for a buffer are
+ * not seen.
+ */
+
+#include <zephyr/types.h>
+
+enum net_stats_pool {
+	NET_STATS_PKT_RX = 0,
+	NET_STATS_PKT_TX,
+	NET_STATS_BUF_RX,
+	NET_STATS_BUF_TX,
+
+	NET_STATS_POOL_COUNT,
+};
+
+struct net_stats_pool_data {
+	u32_t size;
+	u32_t used;
+	u32_t max_used;
+	u32_t exhausted;
+	u32_t exhausted_ms;
+};
+
+/**
+ * @brief Create the LwM2M object instances.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int net_stats_init(void);
+
+/**
+ * @brief Turn periodic sampling of the pools on or off.
+ */
+void net_stats_sampling(bool on);
+
+/**
+ * @brief Check whether the pools are being sampled.
+ */
+bool net_stats_is_sampling(void);
+
+/**
+ * @brief Get the statistics of one pool.
+ */
+const struct net_stats_pool_data *net_stats_get(enum net_stats_pool pool);
+
+/**
+ * @brief Get the name of a pool, for display.
+ */
+const char *net_stats_pool_name(enum net_stats_pool pool);
+
+#endif	/* FOTA_NET_STATS_H__ */
@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_peer
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <flash.h>
+#include <net/socket.h>
+#include <net/coap.h>
+#include <dfu/mcuboot.h>
+
+#include "coap_block.h"
+#include "lwm2m.h"
+#include "peer_server.h"
+
+#define FW_PATH			"fw"
+#define VER_PATH		"ver"
+
+#define BANK_OFFSET		DT_FLASH_AREA_IMAGE_0_OFFSET
+#define BANK_SIZE		DT_FLASH_AREA_IMAGE_0_SIZE
+
+/* MCUboot image layout, as found in flash */
+#define IMAGE_MAGIC		0x96f3b83d
+#define IMAGE_TLV_INFO_MAGIC	0x6907
+
+struct image_header {
+	u32_t magic;
+	u32_t load_addr;
+	u16_t hdr_size;
+	u16_t pad1;
+	u32_t img_size;
+};
+
+struct image_tlv_info {
+	u16_t magic;
+	u16_t tlv_tot;
+};
+
+static struct device *flash_dev;
+static int sock = -1;
+/* size of the image in bank 0, including header and trailing TLVs */
+static size_t image_size;
+/* requests have no payload, but may carry Uri-Host when proxied */
+static u8_t rx_buf[2 * FOTA_COAP_OVERHEAD];
+static u8_t tx_buf[FOTA_BLOCK_SIZE + FOTA_COAP_OVERHEAD];
+static u8_t block_buf[FOTA_BLOCK_SIZE];
+
+static K_THREAD_STACK_DEFINE(peer_server_stack,
+			     CONFIG_FOTA_PEER_SERVER_STACK_SIZE);
+static struct k_thread peer_server_thread_data;
+
+/* Work out how much of bank 0 a neighbor needs: header, image, TLVs. */
+static int image_size_read(void)
+{
+	struct image_header header;
+	struct image_tlv_info info;
+	off_t tlv_offset;
+	int ret;
+
+	ret = flash_read(flash_dev, BANK_OFFSET, &header, sizeof(header));
+	if (ret) {
+		return ret;
+	}
+
+	if (header.magic != IMAGE_MAGIC) {
+		LOG_ERR("No image header in bank 0");
+		return -ENOENT;
+	}
+
+	tlv_offset = header.hdr_size + header.img_size;
+	if (tlv_offset + sizeof(info) > BANK_SIZE) {
+		return -EINVAL;
+	}
+
+	ret = flash_read(flash_dev, BANK_OFFSET + tlv_offset, &info,
+			 sizeof(info));
+	if (ret) {
+		return ret;
+	}
+
+	if (info.magic != IMAGE_TLV_INFO_MAGIC ||
+	    tlv_offset + info.tlv_tot > BANK_SIZE) {
+		LOG_ERR("No TLV area after the bank 0 image");
+		return -ENOENT;
+	}
+
+	image_size = tlv_offset + info.tlv_tot;
+
+	return 0;
+}
+
+static int reply_init(struct coap_packet *reply,
+		      const struct coap_packet *request, u8_t code)
+{
+	u8_t token[8];
+	u8_t tkl, type;
+	u16_t id;
+
+	tkl = coap_header_get_token(request, token);
+	if (coap_header_get_type(request) == COAP_TYPE_CON) {
+		/* piggybacked response */
+		type = COAP_TYPE_ACK;
+		id = coap_header_get_id(request);
+	} else {
+		type = COAP_TYPE_NON_CON;
+		id = coap_next_id();
+	}
+
+	return coap_packet_init(reply, tx_buf, sizeof(tx_buf), 1, type,
+				tkl, token, code, id);
+}
+
+static int send_error(const struct coap_packet *request, u8_t code,
+		      const struct sockaddr *to, socklen_t to_len)
+{
+	struct coap_packet reply;
+	int ret;
+
+	ret = reply_init(&reply, request, code);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = sendto(sock, reply.data, reply.offset, 0, to, to_len);
+
+	return ret < 0 ? -errno : 0;
+}
+
+static int send_version(const struct coap_packet *request,
+			const struct sockaddr *to, socklen_t to_len)
+{
+	const char *version = lwm2m_firmware_version_get();
+	struct coap_packet reply;
+	int ret;
+
+	ret = reply_init(&reply, request, COAP_RESPONSE_CODE_CONTENT);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = coap_append_option_int(&reply, COAP_OPTION_CONTENT_FORMAT,
+				     COAP_CONTENT_FORMAT_TEXT_PLAIN);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = coap_packet_append_payload_marker(&reply);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = coap_packet_append_payload(&reply, (u8_t *)version,
+					 strlen(version));
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = sendto(sock, reply.data, reply.offset, 0, to, to_len);
+
+	return ret < 0 ? -errno : 0;
+}
+
+static int send_block(const struct coap_packet *request,
+		      const struct sockaddr *to, socklen_t to_len)
+{
+	struct coap_packet reply;
+	u8_t szx = FOTA_BLOCK_SZX;
+	u32_t num = 0;
+	off_t offset;
+	size_t len;
+	bool more;
+	int block, ret;
+
+	block = coap_get_option_int(request, COAP_OPTION_BLOCK2);
+	if (block >= 0) {
+		num = FOTA_BLOCK_OPT_NUM(block);
+		if (FOTA_BLOCK_OPT_SZX(block) < FOTA_BLOCK_SZX) {
+			/* the client's buffer is smaller than our blocks */
+			szx = FOTA_BLOCK_OPT_SZX(block);
+		} else {
+			/* we may answer with smaller blocks than asked for */
+			num <<= FOTA_BLOCK_OPT_SZX(block) - FOTA_BLOCK_SZX;
+		}
+	}
+
+	offset = (off_t)num << (szx + 4);
+	if (offset >= image_size) {
+		return send_error(request, COAP_RESPONSE_CODE_BAD_OPTION,
+				  to, to_len);
+	}
+
+	len = MIN(FOTA_BLOCK_SZX_SIZE(szx), image_size - offset);
+	more = offset + len < image_size;
+
+	ret = flash_read(flash_dev, BANK_OFFSET + offset, block_buf, len);
+	if (ret) {
+		LOG_ERR("Failed to read block %u: %d", num, ret);
+		return send_error(request, COAP_RESPONSE_CODE_INTERNAL_ERROR,
+				  to, to_len);
+	}
+
+	ret = reply_init(&reply, request, COAP_RESPONSE_CODE_CONTENT);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = coap_append_option_int(&reply, COAP_OPTION_CONTENT_FORMAT,
+				     COAP_CONTENT_FORMAT_APP_OCTET_STREAM);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = coap_append_option_int(&reply, COAP_OPTION_BLOCK2,
+				     FOTA_BLOCK_OPT(num, more, szx));
+	if (ret < 0) {
+		return ret;
+	}
+
+	if (num == 0) {
+		ret = coap_append_option_int(&reply, COAP_OPTION_SIZE2,
+					     image_size);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+
+	ret = coap_packet_append_payload_marker(&reply);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = coap_packet_append_payload(&reply, block_buf, len);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = sendto(sock, reply.data, reply.offset, 0, to, to_len);
+
+	return ret < 0 ? -errno : 0;
+}
+
+static void handle_request(u8_t *buf, size_t len,
+			   const struct sockaddr *from, socklen_t from_len)
+{
+	struct coap_packet request;
+	struct coap_option path;
+	int ret;
+
+	ret = coap_packet_parse(&request, buf, len, NULL, 0);
+	if (ret < 0) {
+		LOG_DBG("Dropping invalid CoAP packet");
+		return;
+	}
+
+	/* only requests are served; anything else is dropped */
+	if (coap_header_get_code(&request) != COAP_METHOD_GET) {
+		return;
+	}
+
+	ret = coap_find_options(&request, COAP_OPTION_URI_PATH, &path, 1);
+	if (ret != 1) {
+		ret = send_error(&request, COAP_RESPONSE_CODE_NOT_FOUND,
+				 from, from_len);
+	} else if (!boot_is_img_confirmed()) {
+		/* don't hand out an image which may still be reverted */
+		ret = send_error(&request,
+				 COAP_RESPONSE_CODE_SERVICE_UNAVAILABLE,
+				 from, from_len);
+	} else if (path.len == strlen(FW_PATH) &&
+		   !memcmp(path.value, FW_PATH, path.len)) {
+		ret = send_block(&request, from, from_len);
+	} else if (path.len == strlen(VER_PATH) &&
+		   !memcmp(path.value, VER_PATH, path.len)) {
+		ret = send_version(&request, from, from_len);
+	} else {
+		ret = send_error(&request, COAP_RESPONSE_CODE_NOT_FOUND,
+				 from, from_len);
+	}
+
+	if (ret < 0) {
+		LOG_ERR("Failed to answer request: %d", ret);
+	}
+}
+
+static void peer_server_thread(void *p1, void *p2, void *p3)
+{
+	struct sockaddr_in6 from;
+	socklen_t from_len;
+	int ret;
+
+	while (true) {
+		from_len = sizeof(from);
+		ret = recvfrom(sock, rx_buf, sizeof(rx_buf), 0,
+			       (struct sockaddr *)&from, &from_len);
+		if (ret < 0) {
+			LOG_ERR("recvfrom error: %d", -errno);
+			k_sleep(MSEC_PER_SEC);
+			continue;
+		}
+
+		handle_request(rx_buf, ret, (struct sockaddr *)&from,
+			       from_len);
+	}
+}
+
+int peer_server_init(void)
+{
+	struct sockaddr_in6 addr;
+	int ret;
+
+	flash_dev = device_get_binding(DT_FLASH_DEV_NAME);
+	if (!flash_dev) {
+		LOG_ERR("missing flash device %s", DT_FLASH_DEV_NAME);
+		return -ENODEV;
+	}
+
+	ret = image_size_read();
+	if (ret < 0) {
+		return ret;
+	}
+
+	sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0) {
+		LOG_ERR("Failed to create socket: %d", -errno);
+		return -errno;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin6_family = AF_INET6;
+	addr.sin6_port = htons(CONFIG_FOTA_PEER_SERVER_PORT);
+	ret = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+	if (ret < 0) {
+		LOG_ERR("Failed to bind socket: %d", -errno);
+		close(sock);
+		sock = -1;
+		return -errno;
+	}
+
+	k_thread_create(&peer_server_thread_data, peer_server_stack,
+			K_THREAD_STACK_SIZEOF(peer_server_stack),
+			peer_server_thread, NULL, NULL, NULL,
+			K_LOWEST_APPLICATION_THREAD_PRIO, 0, K_NO_WAIT);
+
+	LOG_INF("Serving image %s (%zu bytes) on port %d",
+		lwm2m_firmware_version_get(), image_size,
+		CONFIG_FOTA_PEER_SERVER_PORT);
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_PEER_SERVER_H__
+#define FOTA_PEER_SERVER_H__
+
+/**
+ * @file
+ * @brief Serve the running firmware image to neighbor devices
+ *
+ * Neighbors fetch the confirmed bank 0 image with CoAP GET requests to
+ * "/fw" (blockwise, using Block2), so a device which already runs
+ * version X can be given as the Package URI for the others:
+ * coap://[<address>]:CONFIG_FOTA_PEER_SERVER_PORT/fw
+ *
+ * GET "/ver" returns the version string of that image.
+ */
+
+/**
+ * @brief Start serving the bank 0 image.
+ *
+ * Call this once the running image has been confirmed.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int peer_server_init(void);
+
+#endif	/* FOTA_PEER_SERVER_H__ */
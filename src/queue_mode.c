@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_queue
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <net/lwm2m.h>
+
+#include "app_work_queue.h"
+#include "queue_mode.h"
+
+#define QUEUE_MODE_BINDING	"UQ"
+
+struct held_notify {
+	u16_t obj_id;
+	u16_t obj_inst_id;
+	u16_t res_id;
+};
+
+static struct held_notify held[CONFIG_FOTA_LWM2M_QUEUE_MODE_BUF_COUNT];
+static size_t held_count;
+static bool awake;
+/* Uptime of the last early wakeup request, 0 if none is pending */
+static s64_t wake_requested;
+
+static struct k_delayed_work sleep_work;
+
+static void queue_mode_sleep(struct k_work *work)
+{
+	LOG_DBG("Awake window closed, holding back notifications");
+	awake = false;
+}
+
+/* Send everything that was held back, in order. */
+static void flush_held(void)
+{
+	struct held_notify notify[CONFIG_FOTA_LWM2M_QUEUE_MODE_BUF_COUNT];
+	unsigned int key;
+	size_t count, i;
+
+	key = irq_lock();
+	count = held_count;
+	memcpy(notify, held, count * sizeof(notify[0]));
+	held_count = 0;
+	irq_unlock(key);
+
+	if (count) {
+		LOG_DBG("Sending %zu held back notification(s)", count);
+	}
+
+	for (i = 0; i < count; i++) {
+		lwm2m_notify_observer(notify[i].obj_id, notify[i].obj_inst_id,
+				      notify[i].res_id);
+	}
+}
+
+void queue_mode_uplink(void)
+{
+	unsigned int key;
+
+	key = irq_lock();
+	wake_requested = 0;
+	irq_unlock(key);
+
+	awake = true;
+	app_wq_submit_delayed(&sleep_work,
+			      CONFIG_FOTA_LWM2M_QUEUE_MODE_AWAKE_MS);
+	flush_held();
+}
+
+void queue_mode_notify(u16_t obj_id, u16_t obj_inst_id, u16_t res_id)
+{
+	bool is_held = false, wake = false;
+	unsigned int key;
+	s64_t now;
+	size_t i;
+
+	if (awake) {
+		lwm2m_notify_observer(obj_id, obj_inst_id, res_id);
+		return;
+	}
+
+	key = irq_lock();
+	for (i = 0; i < held_count; i++) {
+		if (held[i].obj_id == obj_id &&
+		    held[i].obj_inst_id == obj_inst_id &&
+		    held[i].res_id == res_id) {
+			/* The value is read when the notification goes */
+			irq_unlock(key);
+			return;
+		}
+	}
+
+	if (held_count < ARRAY_SIZE(held)) {
+		held[held_count].obj_id = obj_id;
+		held[held_count].obj_inst_id = obj_inst_id;
+		held[held_count].res_id = res_id;
+		held_count++;
+		is_held = true;
+	}
+	if (held_count == ARRAY_SIZE(held)) {
+		/*
+		 * Ask once per awake window: the update may take a while
+		 * (or fail and be retried by the RD client), and every
+		 * notification until then lands here.
+		 */
+		now = k_uptime_get();
+		if (!wake_requested || now - wake_requested >=
+		    CONFIG_FOTA_LWM2M_QUEUE_MODE_AWAKE_MS) {
+			wake_requested = now ? now : 1;
+			wake = true;
+		}
+	}
+	irq_unlock(key);
+
+	if (!is_held) {
+		/* No room left for this one; send it right away. */
+		lwm2m_notify_observer(obj_id, obj_inst_id, res_id);
+	}
+
+	if (wake) {
+		/*
+		 * Don't let notifications pile up: wake up now. The
+		 * flush happens once the registration update went
+		 * through.
+		 */
+		LOG_DBG("Notification buffer full, waking up early");
+		lwm2m_rd_client_update();
+	}
+}
+
+int queue_mode_init(void)
+{
+	int ret;
+
+	k_delayed_work_init(&sleep_work, queue_mode_sleep);
+
+	/*
+	 * Zephyr 1.14's RD client doesn't send a binding ("b=") when it
+	 * registers, so the server only learns about Queue Mode by
+	 * reading this resource.
+	 */
+	ret = lwm2m_engine_set_string("1/0/7", QUEUE_MODE_BINDING);
+	if (ret < 0) {
+		LOG_ERR("Failed to set Queue Mode binding: %d", ret);
+		return ret;
+	}
+
+	LOG_INF("Queue Mode enabled, awake window %d ms",
+		CONFIG_FOTA_LWM2M_QUEUE_MODE_AWAKE_MS);
+
+	return 0;
+}
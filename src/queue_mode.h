@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_QUEUE_MODE_H__
+#define FOTA_QUEUE_MODE_H__
+
+/**
+ * @file
+ * @brief LwM2M Queue Mode support
+ *
+ * In Queue Mode the server only sends requests to the device during
+ * a short awake window after each uplink. Notifications of values the
+ * application changes outside of that window are held back, and sent
+ * in one burst on the next wakeup, with the latest values.
+ *
+ * Only notifications of resources set through lwm2m_res_handle_set()
+ * are held back. Those the engine sends on its own, when an
+ * observation's maximum period expires, are not: Zephyr 1.14's engine
+ * has no hook for that.
+ *
+ * The awake window only decides when notifications go out; powering
+ * the radio down in between is left to the network (e.g. the
+ * OpenThread sleepy end device poll period). Zephyr 1.14's RD client
+ * doesn't send the binding when it registers, so "UQ" is only visible
+ * to a server which reads the Server object's Binding (1/0/7).
+ */
+
+#include <zephyr.h>
+#include <zephyr/types.h>
+#include <net/lwm2m.h>
+
+#if defined(CONFIG_FOTA_LWM2M_QUEUE_MODE)
+
+/**
+ * @brief Initialize Queue Mode and set the server binding to "UQ".
+ *
+ * Must be called after the LwM2M engine objects exist and before
+ * lwm2m_rd_client_start().
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int queue_mode_init(void);
+
+/**
+ * @brief Report that an uplink to the server succeeded.
+ *
+ * Opens (or extends) the awake window and sends the notifications
+ * which were held back while asleep.
+ */
+void queue_mode_uplink(void);
+
+/**
+ * @brief Notify observers of a resource whose value changed.
+ *
+ * Notifies right away while awake. Otherwise the notification is held
+ * back until the next wakeup; notifying the same resource again before
+ * then is a no-op. Once the buffer is full, a registration update is
+ * requested to wake up early, at most once per awake window.
+ */
+void queue_mode_notify(u16_t obj_id, u16_t obj_inst_id, u16_t res_id);
+
+#else
+
+static inline int queue_mode_init(void)
+{
+	return 0;
+}
+
+static inline void queue_mode_uplink(void) {}
+
+static inline void queue_mode_notify(u16_t obj_id, u16_t obj_inst_id,
+				     u16_t res_id)
+{
+	lwm2m_notify_observer(obj_id, obj_inst_id, res_id);
+}
+
+#endif /* CONFIG_FOTA_LWM2M_QUEUE_MODE */
+
+#endif	/* FOTA_QUEUE_MODE_H__ */
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_reconnect
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+
+#include "app_work_queue.h"
+#include "product_id.h"
+#include "reconnect.h"
+
+BUILD_ASSERT_MSG(CONFIG_FOTA_RECONNECT_DELAY_MIN_MS > 0 &&
+		 CONFIG_FOTA_RECONNECT_DELAY_MIN_MS <=
+		 CONFIG_FOTA_RECONNECT_DELAY_MAX_MS,
+		 "Invalid reconnect delay range");
+
+static struct reconnect_stats stats;
+static struct k_delayed_work reconnect_work;
+static bool pending;
+static u32_t rand_state;
+static k_work_handler_t reconnect_handler;
+
+/*
+ * xorshift32: good enough to spread out retries, and deterministic
+ * for a given device, which makes fleet behavior reproducible.
+ */
+static u32_t jitter_rand(void)
+{
+	u32_t x = rand_state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	rand_state = x;
+
+	return x;
+}
+
+static u32_t next_delay(void)
+{
+	u32_t delay = CONFIG_FOTA_RECONNECT_DELAY_MIN_MS;
+	u32_t i;
+
+	for (i = 1; i < stats.streak; i++) {
+		if (delay >= CONFIG_FOTA_RECONNECT_DELAY_MAX_MS / 2) {
+			delay = CONFIG_FOTA_RECONNECT_DELAY_MAX_MS;
+			break;
+		}
+		delay *= 2;
+	}
+
+	/* Randomize within [delay / 2, delay] */
+	return delay / 2 + jitter_rand() % (delay / 2 + 1);
+}
+
+/*
+ * Failures are reported from the LwM2M engine's thread, attempts run
+ * on the application work queue: the state is only touched with
+ * interrupts locked.
+ */
+static void reconnect(struct k_work *work)
+{
+	unsigned int key;
+	u32_t attempts, streak;
+
+	key = irq_lock();
+	pending = false;
+	attempts = ++stats.attempts;
+	streak = stats.streak;
+	irq_unlock(key);
+
+	LOG_INF("Reconnect attempt %u (failure streak %u)", attempts, streak);
+	reconnect_handler(work);
+}
+
+void reconnect_schedule(void)
+{
+	unsigned int key;
+	u32_t delay;
+
+	key = irq_lock();
+	stats.failures++;
+	if (pending) {
+		irq_unlock(key);
+		return;
+	}
+
+	stats.streak++;
+	delay = next_delay();
+	stats.last_delay_ms = delay;
+	pending = true;
+	irq_unlock(key);
+
+	LOG_INF("Reconnecting in %u ms", delay);
+	app_wq_submit_delayed(&reconnect_work, delay);
+}
+
+void reconnect_reset(void)
+{
+	unsigned int key;
+	bool was_pending;
+
+	key = irq_lock();
+	was_pending = pending;
+	pending = false;
+	stats.streak = 0;
+	irq_unlock(key);
+
+	if (was_pending) {
+		k_delayed_work_cancel(&reconnect_work);
+	}
+}
+
+void reconnect_stats_get(struct reconnect_stats *out)
+{
+	unsigned int key;
+
+	key = irq_lock();
+	*out = stats;
+	irq_unlock(key);
+}
+
+void reconnect_init(k_work_handler_t handler)
+{
+	reconnect_handler = handler;
+	k_delayed_work_init(&reconnect_work, reconnect);
+
+	/* xorshift must not be seeded with 0 */
+	rand_state = product_id_get()->number ? : 0x9e3779b9;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_RECONNECT_H__
+#define FOTA_RECONNECT_H__
+
+/**
+ * @file
+ * @brief LwM2M server reconnect manager
+ *
+ * Schedules reconnect attempts with a jittered exponential backoff.
+ * The jitter is seeded from the device serial number, so devices which
+ * lost the server at the same time spread their retries out.
+ */
+
+#include <zephyr.h>
+#include <zephyr/types.h>
+
+struct reconnect_stats {
+	/** Reconnect attempts started */
+	u32_t attempts;
+	/** Failures reported since boot */
+	u32_t failures;
+	/** Failures reported since the last success */
+	u32_t streak;
+	/** Last delay used before a reconnect attempt */
+	u32_t last_delay_ms;
+};
+
+/**
+ * @brief Initialize the reconnect manager.
+ *
+ * @param handler Handler which restarts the connection; it runs on
+ *                the application work queue.
+ */
+void reconnect_init(k_work_handler_t handler);
+
+/**
+ * @brief Report a connection failure and schedule a reconnect.
+ *
+ * Only the failure counter is bumped if a reconnect is already
+ * scheduled. The caller keeps the connection down until the handler
+ * runs.
+ */
+void reconnect_schedule(void);
+
+/**
+ * @brief Reset the backoff, after a successful connection or once the
+ * network is back. A scheduled reconnect is cancelled.
+ */
+void reconnect_reset(void);
+
+/**
+ * @brief Get a copy of the reconnect counters.
+ */
+void reconnect_stats_get(struct reconnect_stats *stats);
+
+#endif	/* FOTA_RECONNECT_H__ */
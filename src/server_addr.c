@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_srv_addr
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <net/socket.h>
+
+#include "server_addr.h"
+#include "settings.h"
+
+#if defined(CONFIG_NET_IPV6)
+#define SERVER_FAMILY	AF_INET6
+#else
+#define SERVER_FAMILY	AF_INET
+#endif
+
+static const char *server_host;
+static struct server_addr_cache cache;
+/* cache holds an address for server_host */
+static bool cache_valid;
+/* the cached address failed us; stick to the name until a refresh */
+static bool cache_failed;
+/* uptime at which the cached address expires */
+static s64_t cache_expiry;
+/* cache.ttl as last saved */
+static u32_t saved_ttl;
+static K_MUTEX_DEFINE(cache_lock);
+
+/* getaddrinfo() blocks: keep it off the application work queue */
+static K_THREAD_STACK_DEFINE(resolve_stack,
+			     CONFIG_FOTA_SERVER_ADDR_STACK_SIZE);
+static struct k_work_q resolve_work_q;
+static struct k_work refresh_work;
+static struct k_work save_work;
+
+/* Save the address with what is left of its lifetime. */
+static void cache_save(void)
+{
+	s64_t left = cache_expiry - k_uptime_get();
+	int ret;
+
+	cache.ttl = left > 0 ? left / MSEC_PER_SEC : 0;
+	if (cache.ttl == saved_ttl) {
+		return;
+	}
+
+	ret = fota_server_addr_save(&cache);
+	if (ret) {
+		LOG_ERR("Cannot save server address: %d", ret);
+		return;
+	}
+	saved_ttl = cache.ttl;
+}
+
+/*
+ * Resolve the server name again, when the cache is missing, failed or
+ * expired. Zephyr's resolver doesn't report record TTLs, so a fixed
+ * lifetime stands in for them.
+ */
+static void server_addr_refresh(struct k_work *work)
+{
+	struct addrinfo hints = {
+		.ai_family = SERVER_FAMILY,
+		.ai_socktype = SOCK_DGRAM,
+	};
+	struct addrinfo *res;
+	char addr[INET6_ADDRSTRLEN];
+	void *sin_addr;
+	bool changed;
+	int ret;
+
+	ret = getaddrinfo(server_host, NULL, &hints, &res);
+	if (ret) {
+		LOG_WRN("Cannot resolve %s: %d", server_host, ret);
+		return;
+	}
+
+	if (res->ai_family == AF_INET6) {
+		sin_addr = &net_sin6(res->ai_addr)->sin6_addr;
+	} else {
+		sin_addr = &net_sin(res->ai_addr)->sin_addr;
+	}
+
+	if (!net_addr_ntop(res->ai_family, sin_addr, addr, sizeof(addr))) {
+		freeaddrinfo(res);
+		return;
+	}
+	freeaddrinfo(res);
+
+	k_mutex_lock(&cache_lock, K_FOREVER);
+	changed = !cache_valid || strcmp(cache.addr, addr);
+	strncpy(cache.host, server_host, sizeof(cache.host) - 1);
+	strcpy(cache.addr, addr);
+	cache_valid = true;
+	cache_failed = false;
+	cache_expiry = k_uptime_get() +
+		       (s64_t)CONFIG_FOTA_SERVER_ADDR_MAX_AGE * MSEC_PER_SEC;
+	saved_ttl = 0;
+	cache_save();
+	k_mutex_unlock(&cache_lock);
+
+	if (changed) {
+		LOG_INF("Server %s is at %s", server_host, log_strdup(addr));
+	}
+}
+
+static void server_addr_save(struct k_work *work)
+{
+	k_mutex_lock(&cache_lock, K_FOREVER);
+	if (cache_valid) {
+		cache_save();
+	}
+	k_mutex_unlock(&cache_lock);
+}
+
+bool server_addr_get(char *addr, size_t len)
+{
+	bool found;
+
+	k_mutex_lock(&cache_lock, K_FOREVER);
+	found = cache_valid && !cache_failed;
+	if (found) {
+		strncpy(addr, cache.addr, len - 1);
+		addr[len - 1] = '\0';
+	}
+	k_mutex_unlock(&cache_lock);
+
+	return found;
+}
+
+void server_addr_registered(void)
+{
+	bool stale;
+
+	if (!server_host) {
+		return;
+	}
+
+	k_mutex_lock(&cache_lock, K_FOREVER);
+	stale = !cache_valid || cache_failed ||
+		k_uptime_get() >= cache_expiry;
+	k_mutex_unlock(&cache_lock);
+
+	if (stale) {
+		k_work_submit_to_queue(&resolve_work_q, &refresh_work);
+	} else {
+		/* carry the lifetime used up so far over to the next boot */
+		k_work_submit_to_queue(&resolve_work_q, &save_work);
+	}
+}
+
+bool server_addr_fallback(void)
+{
+	bool fallback;
+
+	k_mutex_lock(&cache_lock, K_FOREVER);
+	fallback = cache_valid && !cache_failed;
+	if (fallback) {
+		LOG_WRN("Cached address %s failed, resolving %s again",
+			log_strdup(cache.addr), server_host);
+	}
+	cache_failed = true;
+	k_mutex_unlock(&cache_lock);
+
+	return fallback;
+}
+
+void server_addr_init(const char *host)
+{
+	struct in6_addr addr;
+
+	/* numeric addresses need no resolving */
+	if (net_addr_pton(SERVER_FAMILY, host, &addr) == 0) {
+		return;
+	}
+
+	if (strlen(host) >= sizeof(cache.host)) {
+		LOG_WRN("Server name too long to cache");
+		return;
+	}
+
+	k_work_q_start(&resolve_work_q, resolve_stack,
+		       K_THREAD_STACK_SIZEOF(resolve_stack),
+		       K_LOWEST_APPLICATION_THREAD_PRIO);
+	k_work_init(&refresh_work, server_addr_refresh);
+	k_work_init(&save_work, server_addr_save);
+
+	server_host = host;
+	cache_valid = !fota_server_addr_read(&cache) &&
+		      !strcmp(cache.host, host);
+	if (!cache_valid) {
+		return;
+	}
+
+	saved_ttl = cache.ttl;
+	cache_expiry = k_uptime_get() + (s64_t)cache.ttl * MSEC_PER_SEC;
+	if (cache.ttl) {
+		LOG_INF("Using cached address %s for %s (%u s left)",
+			cache.addr, host, cache.ttl);
+	} else {
+		/* expired: still better than waiting for DNS */
+		LOG_INF("Using expired address %s for %s", cache.addr, host);
+	}
+}
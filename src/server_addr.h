@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_SERVER_ADDR_H__
+#define FOTA_SERVER_ADDR_H__
+
+/**
+ * @file
+ * @brief LwM2M server address cache
+ *
+ * Remembers which address the server name resolved to, so the next
+ * boot can register without waiting for DNS. The address is saved with
+ * what is left of its lifetime, CONFIG_FOTA_SERVER_ADDR_MAX_AGE from
+ * when it was resolved, counted in uptime: the device has no clock to
+ * tell how long it was off. The name is resolved again on a thread of
+ * its own after a registration, if the cached address failed or
+ * expired.
+ */
+
+#include <zephyr.h>
+#include <zephyr/types.h>
+
+#if defined(CONFIG_FOTA_SERVER_ADDR_CACHE)
+
+/**
+ * @brief Load the cached address of a server.
+ *
+ * Settings must have been loaded. Nothing is cached for numeric
+ * addresses.
+ *
+ * @param host Server name or address; must stay valid.
+ */
+void server_addr_init(const char *host);
+
+/**
+ * @brief Get the cached server address.
+ *
+ * @param addr Buffer for the numeric address.
+ * @param len  Size of the buffer.
+ * @return true if addr holds an address, false if the server name
+ *         should be used.
+ */
+bool server_addr_get(char *addr, size_t len);
+
+/**
+ * @brief Report a registration; refreshes a stale cache in the
+ *        background, or saves the lifetime left of a fresh one.
+ */
+void server_addr_registered(void);
+
+/**
+ * @brief Report a connection failure.
+ *
+ * @return true if the cached address was in use; server_addr_get()
+ *         returns false from now on, until the next refresh.
+ */
+bool server_addr_fallback(void);
+
+#else
+
+static inline void server_addr_init(const char *host)
+{
+	ARG_UNUSED(host);
+}
+
+static inline bool server_addr_get(char *addr, size_t len)
+{
+	ARG_UNUSED(addr);
+	ARG_UNUSED(len);
+
+	return false;
+}
+
+static inline void server_addr_registered(void) {}
+
+static inline bool server_addr_fallback(void)
+{
+	return false;
+}
+
+#endif /* CONFIG_FOTA_SERVER_ADDR_CACHE */
+
+#endif	/* FOTA_SERVER_ADDR_H__ */
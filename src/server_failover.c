@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_MODULE_NAME fota_failover
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+
+#include "app_work_queue.h"
+#include "server_failover.h"
+
+/* Without a secondary server, only the health counters are kept */
+#define HAS_SECONDARY	(sizeof(CONFIG_FOTA_SECONDARY_SERVER_ADDR) > 1)
+
+static struct server_health health[SERVER_COUNT];
+static enum server_id current;
+static s64_t connect_start;
+static bool connecting;
+/* connected to the primary only to check whether it is back */
+static bool probing;
+static u32_t failback_delay_s = CONFIG_FOTA_SERVER_FAILBACK_DELAY_S;
+
+static struct k_delayed_work failback_work;
+static struct k_work switch_work;
+static k_work_handler_t restart_handler;
+
+/*
+ * Registrations are reported from the LwM2M engine's thread, attempts
+ * and failback run on the application work queue: the state is only
+ * touched with interrupts locked.
+ */
+
+static const char *server_name(enum server_id id)
+{
+	return id == SERVER_PRIMARY ? "primary" : "secondary";
+}
+
+static void server_switch(enum server_id id)
+{
+	LOG_WRN("Switching to the %s server", server_name(id));
+	k_delayed_work_cancel(&failback_work);
+	current = id;
+	health[id].streak = 0;
+}
+
+static void failback(struct k_work *work)
+{
+	unsigned int key;
+
+	key = irq_lock();
+	if (current != SERVER_SECONDARY) {
+		irq_unlock(key);
+		return;
+	}
+
+	probing = true;
+	server_switch(SERVER_PRIMARY);
+	irq_unlock(key);
+
+	LOG_INF("Checking whether the primary server is back");
+	/* deregisters from the secondary before connecting to the primary */
+	restart_handler(work);
+}
+
+enum server_id server_failover_current(void)
+{
+	return current;
+}
+
+const char *server_failover_secondary_addr(void)
+{
+	return CONFIG_FOTA_SECONDARY_SERVER_ADDR;
+}
+
+void server_failover_connecting(void)
+{
+	unsigned int key;
+
+	key = irq_lock();
+	connect_start = k_uptime_get();
+	connecting = true;
+	irq_unlock(key);
+}
+
+void server_failover_registered(void)
+{
+	struct server_health *h;
+	unsigned int key;
+	u32_t rtt;
+
+	key = irq_lock();
+	if (!connecting) {
+		irq_unlock(key);
+		return;
+	}
+
+	h = &health[current];
+	connecting = false;
+	rtt = k_uptime_get() - connect_start;
+	h->rtt_ms = h->rtt_ms ? (3 * h->rtt_ms + rtt) / 4 : rtt;
+	h->registrations++;
+	LOG_INF("Registered with the %s server in %u ms (average %u ms)",
+		server_name(current), rtt, h->rtt_ms);
+
+	if (CONFIG_FOTA_SERVER_SLOW_RTT_MS &&
+	    rtt > CONFIG_FOTA_SERVER_SLOW_RTT_MS && !probing) {
+		/* registered, but this server is struggling */
+		if (++h->streak >= CONFIG_FOTA_SERVER_FAILOVER_THRESHOLD &&
+		    HAS_SECONDARY) {
+			server_switch(current == SERVER_PRIMARY ?
+				      SERVER_SECONDARY : SERVER_PRIMARY);
+			app_wq_submit(&switch_work);
+			irq_unlock(key);
+			return;
+		}
+	} else {
+		h->streak = 0;
+	}
+
+	if (current == SERVER_PRIMARY) {
+		if (probing) {
+			LOG_INF("Primary server is back");
+			probing = false;
+			failback_delay_s = CONFIG_FOTA_SERVER_FAILBACK_DELAY_S;
+		}
+	} else if (!k_delayed_work_remaining_get(&failback_work)) {
+		app_wq_submit_delayed(&failback_work,
+				      K_SECONDS(failback_delay_s));
+	}
+	irq_unlock(key);
+}
+
+void server_failover_failure(void)
+{
+	struct server_health *h;
+	unsigned int key;
+
+	key = irq_lock();
+	h = &health[current];
+	connecting = false;
+	h->failures++;
+	h->streak++;
+
+	if (probing) {
+		/* still down: wait longer before the next check */
+		probing = false;
+		failback_delay_s = MIN(2 * failback_delay_s,
+				       CONFIG_FOTA_SERVER_FAILBACK_DELAY_MAX_S);
+		server_switch(SERVER_SECONDARY);
+	} else if (h->streak >= CONFIG_FOTA_SERVER_FAILOVER_THRESHOLD &&
+		   HAS_SECONDARY) {
+		server_switch(current == SERVER_PRIMARY ?
+			      SERVER_SECONDARY : SERVER_PRIMARY);
+	}
+	irq_unlock(key);
+}
+
+void server_failover_health_get(enum server_id id,
+				struct server_health *out)
+{
+	unsigned int key;
+
+	key = irq_lock();
+	*out = health[id];
+	irq_unlock(key);
+}
+
+void server_failover_init(k_work_handler_t handler)
+{
+	restart_handler = handler;
+	k_delayed_work_init(&failback_work, failback);
+	k_work_init(&switch_work, handler);
+
+	if (HAS_SECONDARY) {
+		LOG_INF("Secondary server: %s",
+			CONFIG_FOTA_SECONDARY_SERVER_ADDR);
+	} else {
+		LOG_WRN("No secondary server set, failover disabled");
+	}
+}
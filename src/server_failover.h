@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_SERVER_FAILOVER_H__
+#define FOTA_SERVER_FAILOVER_H__
+
+/**
+ * @file
+ * @brief LwM2M server failover
+ *
+ * Tracks the health of the primary and secondary servers and picks
+ * the one to register with. After enough failed (or too slow)
+ * registrations in a row the device switches servers. While on the
+ * secondary, it probes the primary again after a delay which doubles
+ * each time the primary is still down.
+ *
+ * Zephyr 1.14's RD client always registers with the first
+ * non-bootstrap Security object instance, so switching servers
+ * rewrites the Server URI of that instance (0/0/0) instead of
+ * selecting a second Security/Server instance. Both servers therefore
+ * share one set of credentials and server settings.
+ *
+ * Without CONFIG_FOTA_SECONDARY_SERVER_ADDR, only the health of the
+ * primary server is tracked.
+ */
+
+#include <zephyr.h>
+#include <zephyr/types.h>
+
+enum server_id {
+	SERVER_PRIMARY = 0,
+	SERVER_SECONDARY,
+
+	SERVER_COUNT,
+};
+
+struct server_health {
+	/** Smoothed registration round trip time, 0 if unknown */
+	u32_t rtt_ms;
+	/** Failed or slow registrations in a row */
+	u32_t streak;
+	/** Successful registrations since boot */
+	u32_t registrations;
+	/** Failures since boot */
+	u32_t failures;
+};
+
+#if defined(CONFIG_FOTA_SERVER_FAILOVER)
+
+/**
+ * @brief Initialize server failover.
+ *
+ * @param handler Handler which restarts the connection; it runs on
+ *                the application work queue.
+ */
+void server_failover_init(k_work_handler_t handler);
+
+/**
+ * @brief Get the server to connect to.
+ */
+enum server_id server_failover_current(void);
+
+/**
+ * @brief Get the secondary server address.
+ */
+const char *server_failover_secondary_addr(void);
+
+/**
+ * @brief Report that a registration attempt starts.
+ */
+void server_failover_connecting(void);
+
+/**
+ * @brief Report a successful registration.
+ */
+void server_failover_registered(void);
+
+/**
+ * @brief Report a failed registration or a lost connection.
+ *
+ * May switch servers; the next connection attempt uses the new one.
+ */
+void server_failover_failure(void);
+
+/**
+ * @brief Get a copy of the health counters of a server.
+ */
+void server_failover_health_get(enum server_id id,
+				struct server_health *health);
+
+#else
+
+static inline void server_failover_init(k_work_handler_t handler)
+{
+	ARG_UNUSED(handler);
+}
+
+static inline enum server_id server_failover_current(void)
+{
+	return SERVER_PRIMARY;
+}
+
+static inline const char *server_failover_secondary_addr(void)
+{
+	return NULL;
+}
+
+static inline void server_failover_connecting(void) {}
+static inline void server_failover_registered(void) {}
+static inline void server_failover_failure(void) {}
+
+#endif /* CONFIG_FOTA_SERVER_FAILOVER */
+
+#endif	/* FOTA_SERVER_FAILOVER_H__ */
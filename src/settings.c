@@ -16,6 +16,8 @@ LOG_MODULE_REGISTER(LOG_MODULE_NAME);
 #include "settings.h"
 
 static struct update_counter uc;
+static u32_t bt_reboots;
+static struct server_addr_cache srv_addr;
 
 int fota_update_counter_read(struct update_counter *update_counter)
 {
@@ -34,6 +36,37 @@ int fota_update_counter_update(update_counter_t type, u32_t new_value)
 	return settings_save_one("fota/counter", &uc, sizeof(uc));
 }
 
+u32_t fota_bt_reboot_count_read(void)
+{
+	return bt_reboots;
+}
+
+int fota_bt_reboot_count_increment(void)
+{
+	bt_reboots++;
+
+	return settings_save_one("fota/bt_reboots", &bt_reboots,
+				 sizeof(bt_reboots));
+}
+
+int fota_server_addr_read(struct server_addr_cache *cache)
+{
+	if (!srv_addr.host[0]) {
+		return -ENOENT;
+	}
+
+	memcpy(cache, &srv_addr, sizeof(srv_addr));
+	return 0;
+}
+
+int fota_server_addr_save(const struct server_addr_cache *cache)
+{
+	memcpy(&srv_addr, cache, sizeof(srv_addr));
+
+	return settings_save_one("fota/srv_addr", &srv_addr,
+				 sizeof(srv_addr));
+}
+
 static int set(int argc, char **argv, void *val_ctx)
 {
 	int len;
@@ -52,6 +85,30 @@ static int set(int argc, char **argv, void *val_ctx)
 		return 0;
 	}
 
+	if (!strcmp(argv[0], "bt_reboots")) {
+		len = settings_val_read_cb(val_ctx, &bt_reboots,
+					   sizeof(bt_reboots));
+		if (len < sizeof(bt_reboots)) {
+			LOG_ERR("Unable to read BT reboot count.  Resetting.");
+			bt_reboots = 0;
+		}
+
+		return 0;
+	}
+
+	if (!strcmp(argv[0], "srv_addr")) {
+		len = settings_val_read_cb(val_ctx, &srv_addr,
+					   sizeof(srv_addr));
+		if (len < sizeof(srv_addr) ||
+		    srv_addr.host[sizeof(srv_addr.host) - 1] ||
+		    srv_addr.addr[sizeof(srv_addr.addr) - 1]) {
+			LOG_ERR("Unable to read server address.  Ignoring.");
+			memset(&srv_addr, 0, sizeof(srv_addr));
+		}
+
+		return 0;
+	}
+
 	return -ENOENT;
 }
 
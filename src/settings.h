@@ -7,6 +7,8 @@
 #ifndef FOTA_STORAGE_H__
 #define FOTA_STORAGE_H__
 
+#include <net/net_ip.h>
+
 struct update_counter {
 	int current;
 	int update;
@@ -17,8 +19,20 @@ typedef enum {
 	COUNTER_UPDATE,
 } update_counter_t;
 
+/* Address a server name resolved to */
+struct server_addr_cache {
+	char host[64];
+	char addr[INET6_ADDRSTRLEN];
+	/* seconds of uptime left before it must be resolved again */
+	u32_t ttl;
+};
+
 int fota_update_counter_read(struct update_counter *update_counter);
 int fota_update_counter_update(update_counter_t type, u32_t new_value);
+u32_t fota_bt_reboot_count_read(void);
+int fota_bt_reboot_count_increment(void);
+int fota_server_addr_read(struct server_addr_cache *cache);
+int fota_server_addr_save(const struct server_addr_cache *cache);
 int fota_settings_init(void);
 
 #endif	/* FOTA_STORAGE_H__ */
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_SIM_H__
+#define FOTA_SIM_H__
+
+/**
+ * @file
+ * @brief Simulated device (native_posix)
+ *
+ * Stand-ins for the hardware the application expects:
+ *
+ * - a "fota-temp" temperature sensor,
+ * - a GPIO port for the LED,
+ * - flash which survives reboots (--flash=<file>), and an MCUboot
+ *   style swap of the image banks when an upgrade was requested.
+ */
+
+#define SIM_GPIO_NAME		"GPIO_SIM"
+#define SIM_LED_PIN		0
+
+#endif	/* FOTA_SIM_H__ */
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Keep the simulated flash across runs, and stand in for MCUboot.
+ *
+ * With --flash=<file>, the flash contents are loaded from the file at
+ * boot and saved back when the process exits (sys_reboot() exits on
+ * native_posix). If an upgrade was requested, the image banks are
+ * swapped at the next boot, like an MCUboot test swap would. Reverts
+ * of unconfirmed images are not simulated.
+ */
+
+#define LOG_MODULE_NAME fota_sim_flash
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <init.h>
+#include <flash.h>
+#include <soc.h>
+#include "cmdline.h"
+
+#include "sim.h"
+#include "sim_flash_adapt.h"
+
+#define BANK0_OFFSET		DT_FLASH_AREA_IMAGE_0_OFFSET
+#define BANK1_OFFSET		DT_FLASH_AREA_IMAGE_1_OFFSET
+#define BANK_SIZE		DT_FLASH_AREA_IMAGE_1_SIZE
+#define SECTOR_SIZE		DT_FLASH_ERASE_BLOCK_SIZE
+
+/* MCUboot trailer magic, at the very end of a bank */
+static const u32_t boot_img_magic[] = {
+	0xf395c277,
+	0x7fefd260,
+	0x0f505235,
+	0x8079b62c,
+};
+
+static char *flash_file;
+static struct device *flash_dev;
+static size_t flash_size;
+static u8_t buf_a[SECTOR_SIZE];
+static u8_t buf_b[SECTOR_SIZE];
+
+static void sim_flash_options(void)
+{
+	static struct args_struct_t options[] = {
+		{
+			.option = "flash",
+			.name = "file",
+			.type = 's',
+			.dest = (void *)&flash_file,
+			.descript = "Keep the simulated flash in this file",
+		},
+		ARG_TABLE_ENDMARKER
+	};
+
+	native_add_command_line_opts(options);
+}
+
+NATIVE_TASK(sim_flash_options, PRE_BOOT_1, 10);
+
+static int sector_swap(off_t offset)
+{
+	int ret;
+
+	ret = flash_read(flash_dev, BANK0_OFFSET + offset, buf_a, SECTOR_SIZE);
+	ret = ret ? : flash_read(flash_dev, BANK1_OFFSET + offset, buf_b,
+				 SECTOR_SIZE);
+	ret = ret ? : flash_erase(flash_dev, BANK0_OFFSET + offset,
+				  SECTOR_SIZE);
+	ret = ret ? : flash_erase(flash_dev, BANK1_OFFSET + offset,
+				  SECTOR_SIZE);
+	ret = ret ? : flash_write(flash_dev, BANK0_OFFSET + offset, buf_b,
+				  SECTOR_SIZE);
+	ret = ret ? : flash_write(flash_dev, BANK1_OFFSET + offset, buf_a,
+				  SECTOR_SIZE);
+
+	return ret;
+}
+
+/* Swap the banks if bank 1 holds an image marked for upgrade. */
+static int boot_swap(void)
+{
+	u32_t magic[ARRAY_SIZE(boot_img_magic)];
+	off_t offset;
+	int ret;
+
+	ret = flash_read(flash_dev, BANK1_OFFSET + BANK_SIZE - sizeof(magic),
+			 magic, sizeof(magic));
+	if (ret || memcmp(magic, boot_img_magic, sizeof(magic))) {
+		return ret;
+	}
+
+	LOG_INF("Upgrade requested, swapping image banks");
+	flash_write_protection_set(flash_dev, false);
+	for (offset = 0; offset < BANK_SIZE && !ret; offset += SECTOR_SIZE) {
+		ret = sector_swap(offset);
+	}
+
+	/* what used to be the bank 0 trailer must not trigger a swap */
+	ret = ret ? : flash_erase(flash_dev,
+				  BANK1_OFFSET + BANK_SIZE - SECTOR_SIZE,
+				  SECTOR_SIZE);
+	flash_write_protection_set(flash_dev, true);
+
+	return ret;
+}
+
+static int flash_load(void)
+{
+	off_t offset;
+	int fd, len, ret = 0;
+
+	fd = sim_flash_file_open(flash_file, false);
+	if (fd < 0) {
+		LOG_INF("No %s yet, starting with erased flash", flash_file);
+		return 0;
+	}
+
+	flash_write_protection_set(flash_dev, false);
+	for (offset = 0; offset < flash_size && !ret; offset += SECTOR_SIZE) {
+		len = sim_flash_file_read(fd, buf_a, SECTOR_SIZE);
+		if (len <= 0) {
+			break;
+		}
+
+		ret = flash_erase(flash_dev, offset, SECTOR_SIZE);
+		ret = ret ? : flash_write(flash_dev, offset, buf_a, len);
+	}
+	flash_write_protection_set(flash_dev, true);
+	sim_flash_file_close(fd);
+
+	return ret;
+}
+
+static void sim_flash_save(void)
+{
+	off_t offset;
+	int fd;
+
+	if (!flash_file || !flash_dev) {
+		return;
+	}
+
+	fd = sim_flash_file_open(flash_file, true);
+	if (fd < 0) {
+		return;
+	}
+
+	for (offset = 0; offset < flash_size; offset += SECTOR_SIZE) {
+		if (flash_read(flash_dev, offset, buf_a, SECTOR_SIZE) ||
+		    sim_flash_file_write(fd, buf_a, SECTOR_SIZE) !=
+		    SECTOR_SIZE) {
+			break;
+		}
+	}
+
+	sim_flash_file_close(fd);
+}
+
+NATIVE_TASK(sim_flash_save, ON_EXIT, 10);
+
+static int sim_flash_init(struct device *dev)
+{
+	struct flash_pages_info info;
+	size_t pages;
+	int ret;
+
+	ARG_UNUSED(dev);
+
+	flash_dev = device_get_binding(DT_FLASH_DEV_NAME);
+	if (!flash_dev) {
+		return -ENODEV;
+	}
+
+	pages = flash_get_page_count(flash_dev);
+	ret = flash_get_page_info_by_idx(flash_dev, pages - 1, &info);
+	if (ret) {
+		return ret;
+	}
+	flash_size = info.start_offset + info.size;
+
+	if (flash_file) {
+		ret = flash_load();
+		if (ret) {
+			LOG_ERR("Failed to load %s: %d", flash_file, ret);
+			return ret;
+		}
+	}
+
+	return boot_swap();
+}
+
+/* before settings are loaded and the image state is checked */
+SYS_INIT(sim_flash_init, APPLICATION, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Host side of the simulated flash: this file is built against the
+ * host C library, with NO_POSIX_CHEATS, so open() and friends are the
+ * host's and not Zephyr's socket API. Don't include Zephyr headers.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sim_flash_adapt.h"
+
+int sim_flash_file_open(const char *path, bool write)
+{
+	int fd;
+
+	if (write) {
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	} else {
+		fd = open(path, O_RDONLY);
+	}
+
+	return fd < 0 ? -errno : fd;
+}
+
+int sim_flash_file_read(int fd, void *buf, size_t len)
+{
+	ssize_t ret = read(fd, buf, len);
+
+	return ret < 0 ? -errno : (int)ret;
+}
+
+int sim_flash_file_write(int fd, const void *buf, size_t len)
+{
+	ssize_t ret = write(fd, buf, len);
+
+	return ret < 0 ? -errno : (int)ret;
+}
+
+void sim_flash_file_close(int fd)
+{
+	close(fd);
+}
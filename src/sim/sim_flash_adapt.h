@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FOTA_SIM_FLASH_ADAPT_H__
+#define FOTA_SIM_FLASH_ADAPT_H__
+
+/**
+ * @file
+ * @brief Host file access for the simulated flash
+ *
+ * Implemented in sim_flash_adapt.c, which is built against the host
+ * C library rather than Zephyr, like the native_posix *_adapt.c
+ * drivers. Only plain C types cross this interface.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Open a host file.
+ *
+ * @param path File name.
+ * @param write Open for writing, creating or truncating the file,
+ *              instead of reading.
+ * @return File descriptor, or negative errno.
+ */
+int sim_flash_file_open(const char *path, bool write);
+
+/**
+ * @brief Read from a host file.
+ *
+ * @return Number of bytes read, 0 at end of file, or negative errno.
+ */
+int sim_flash_file_read(int fd, void *buf, size_t len);
+
+/**
+ * @brief Write to a host file.
+ *
+ * @return Number of bytes written, or negative errno.
+ */
+int sim_flash_file_write(int fd, const void *buf, size_t len);
+
+/**
+ * @brief Close a host file.
+ */
+void sim_flash_file_close(int fd);
+
+#endif	/* FOTA_SIM_FLASH_ADAPT_H__ */
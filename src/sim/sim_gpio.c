@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Simulated GPIO port, which logs what is written to it. */
+
+#define LOG_MODULE_NAME fota_sim_gpio
+#define LOG_LEVEL CONFIG_FOTA_LOG_LEVEL
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(LOG_MODULE_NAME);
+
+#include <zephyr.h>
+#include <device.h>
+#include <gpio.h>
+
+#include "sim.h"
+
+static u32_t pin_values;
+
+static int sim_gpio_config(struct device *dev, int access_op, u32_t pin,
+			   int flags)
+{
+	return access_op == GPIO_ACCESS_BY_PIN ? 0 : -ENOTSUP;
+}
+
+static int sim_gpio_write(struct device *dev, int access_op, u32_t pin,
+			  u32_t value)
+{
+	if (access_op != GPIO_ACCESS_BY_PIN) {
+		return -ENOTSUP;
+	}
+
+	if (value) {
+		pin_values |= BIT(pin);
+	} else {
+		pin_values &= ~BIT(pin);
+	}
+
+	LOG_INF("GPIO pin %u %s", pin, value ? "high" : "low");
+
+	return 0;
+}
+
+static int sim_gpio_read(struct device *dev, int access_op, u32_t pin,
+			 u32_t *value)
+{
+	if (access_op != GPIO_ACCESS_BY_PIN) {
+		return -ENOTSUP;
+	}
+
+	*value = !!(pin_values & BIT(pin));
+
+	return 0;
+}
+
+static const struct gpio_driver_api sim_gpio_api = {
+	.config = sim_gpio_config,
+	.write = sim_gpio_write,
+	.read = sim_gpio_read,
+};
+
+static int sim_gpio_init(struct device *dev)
+{
+	return 0;
+}
+
+DEVICE_AND_API_INIT(sim_gpio, SIM_GPIO_NAME, sim_gpio_init, NULL, NULL,
+		    POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEVICE,
+		    &sim_gpio_api);
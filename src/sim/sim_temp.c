@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2019 Foundries.io
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Simulated "fota-temp" temperature sensor. */
+
+#include <zephyr.h>
+#include <device.h>
+#include <sensor.h>
+
+/* slowly swing between 20 and 25 C, one step per sample */
+#define TEMP_MIN_MILLI		20000
+#define TEMP_MAX_MILLI		25000
+#define TEMP_STEP_MILLI		125
+
+static s32_t temp_milli = TEMP_MIN_MILLI;
+static s32_t temp_step = TEMP_STEP_MILLI;
+
+static int sim_temp_sample_fetch(struct device *dev, enum sensor_channel chan)
+{
+	temp_milli += temp_step;
+	if (temp_milli >= TEMP_MAX_MILLI || temp_milli <= TEMP_MIN_MILLI) {
+		temp_step = -temp_step;
+	}
+
+	return 0;
+}
+
+static int sim_temp_channel_get(struct device *dev, enum sensor_channel chan,
+				struct sensor_value *val)
+{
+	if (chan != SENSOR_CHAN_DIE_TEMP) {
+		return -ENOTSUP;
+	}
+
+	val->val1 = temp_milli / 1000;
+	val->val2 = (temp_milli % 1000) * 1000;
+
+	return 0;
+}
+
+static const struct sensor_driver_api sim_temp_api = {
+	.sample_fetch = sim_temp_sample_fetch,
+	.channel_get = sim_temp_channel_get,
+};
+
+static int sim_temp_init(struct device *dev)
+{
+	return 0;
+}
+
+DEVICE_AND_API_INIT(sim_temp, "fota-temp", sim_temp_init, NULL, NULL,
+		    POST_KERNEL, CONFIG_SENSOR_INIT_PRIORITY, &sim_temp_api);